@@ -0,0 +1,462 @@
+// Throughput of the three stages of the tree-walking interpreter on the CODE
+// programs in programs/: lexer tokens per second, parser nodes per second and
+// evaluator statements per second, and the lexer's rate in megabytes of
+// source per second. The bytecode VM runs the same programs as a fourth
+// stage, rated in the evaluator's statements so the two compare directly.
+// Each stage runs a few times untimed to warm up, then a number of timed
+// repetitions, and the median and 95th percentile of those are reported, as
+// a table or as JSON for comparing runs.
+//
+// Usage: Benchmark [--dir=programs] [--warmup=3] [--repetitions=20] [--json]
+//                  [--scan=scalar|sse2|avx2]
+//
+// --scan picks the lexer's scanning kernel (see Scan.h), by default the
+// fastest one the processor has.
+//
+// A program <name>.code that SCANs reads <name>.in, every run from the start.
+// DISPLAY output is discarded.
+#include "Compiler.h"
+#include "Evaluator.h"
+#include "Parser.h"
+#include "Resolver.h"
+#include "Scan.h"
+#include "Source.h"
+#include "TokenStream.h"
+#include "VM.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#define open _open
+#define close _close
+#define dup2 _dup2
+#define O_RDONLY _O_RDONLY
+#define NULL_DEVICE "NUL"
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#define NULL_DEVICE "/dev/null"
+#endif
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    std::string dir = "programs";
+    int warmup = 3;
+    int repetitions = 20;
+    bool json = false;
+};
+
+// Timings of one stage over the repetitions, and how much work one run does
+struct Measurement {
+    std::size_t units = 0;         // Tokens, nodes or statements per run
+    std::vector<double> seconds;   // One per repetition
+
+    double Percentile(double p) const {
+        std::vector<double> sorted = seconds;
+        std::sort(sorted.begin(), sorted.end());
+        std::size_t index = static_cast<std::size_t>(p * (sorted.size() - 1) + 0.5);
+        return sorted[index];
+    }
+
+    double Median() const { return Percentile(0.5); }
+    double P95() const { return Percentile(0.95); }
+    double Rate() const { return units / Median(); }
+};
+
+struct Result {
+    std::string name;
+    std::size_t bytes = 0;
+    Measurement lexer;
+    Measurement parser;
+    Measurement evaluator;
+    Measurement vm;
+};
+
+// The parser and the structure check print to std::cout. Nothing should reach
+// the terminal while a stage is being timed.
+class SilenceCout {
+public:
+    SilenceCout() : saved(std::cout.rdbuf(nullptr)) {}
+    ~SilenceCout() {
+        std::cout.rdbuf(saved);
+        std::cout.clear();
+    }
+
+private:
+    std::streambuf* saved;
+};
+
+// Shortest sample worth timing. Lexing or parsing a small program takes a few
+// microseconds, close to what the clock can resolve, so such a body is run
+// several times in a row per sample and the time divided between them.
+constexpr std::chrono::microseconds MinSample(1000);
+
+// Times body(setup()) over batch runs, leaving the setups out
+template <typename Setup, typename Body>
+std::chrono::duration<double> timeBatch(int batch, Setup& setup, Body& body) {
+    std::vector<decltype(setup())> inputs;
+    inputs.reserve(batch);
+    for (int j = 0; j < batch; j++) {
+        inputs.push_back(setup());
+    }
+
+    auto start = Clock::now();
+    for (auto& input : inputs) {
+        body(input);
+    }
+    return Clock::now() - start;
+}
+
+// Runs warmup + repetitions samples of body and records the timed ones. Each
+// run of body gets a fresh input from setup, made outside the timing.
+template <typename Setup, typename Body>
+void measure(const Options& options, Measurement& measurement, Setup setup, Body body) {
+    int batch = 1;
+    while (batch < (1 << 20) && timeBatch(batch, setup, body) < MinSample) {
+        batch *= 2;
+    }
+
+    for (int i = 0; i < options.warmup + options.repetitions; i++) {
+        auto elapsed = timeBatch(batch, setup, body);
+        if (i >= options.warmup) {
+            measurement.seconds.push_back(elapsed.count() / batch);
+        }
+    }
+}
+
+std::size_t countNodes(const Node* node);
+
+template <typename T>
+std::size_t countAll(const std::vector<std::unique_ptr<T>>& nodes) {
+    std::size_t count = 0;
+    for (const auto& node : nodes) {
+        count += countNodes(node.get());
+    }
+    return count;
+}
+
+std::size_t countNodes(const Node* node) {
+    if (node == nullptr) {
+        return 0;
+    }
+
+    std::size_t count = 1;
+    switch (node->Kind) {
+    case NodeKind::Program:
+        count += countAll(static_cast<const Program*>(node)->Statements);
+        break;
+    case NodeKind::TypedDeclStatement: {
+        auto decl = static_cast<const TypedDeclStatement*>(node);
+        count += countNodes(decl->Name.get()) + countNodes(decl->Value.get());
+        break;
+    }
+    case NodeKind::MultiTypedDeclStatement: {
+        auto decl = static_cast<const MultiTypedDeclStatement*>(node);
+        count += countAll(decl->Names) + countAll(decl->Values);
+        break;
+    }
+    case NodeKind::ReturnStatement:
+        count += countNodes(static_cast<const ReturnStatement*>(node)->ReturnValue.get());
+        break;
+    case NodeKind::ExpressionStatement:
+        count += countNodes(static_cast<const ExpressionStatement*>(node)->Expression_.get());
+        break;
+    case NodeKind::PrefixExpression:
+        count += countNodes(static_cast<const PrefixExpression*>(node)->Right.get());
+        break;
+    case NodeKind::InfixExpression: {
+        auto infix = static_cast<const InfixExpression*>(node);
+        count += countNodes(infix->Left.get()) + countNodes(infix->Right.get());
+        break;
+    }
+    case NodeKind::BlockStatement:
+        count += countAll(static_cast<const BlockStatement*>(node)->Statements);
+        break;
+    case NodeKind::IfExpression: {
+        auto ifExpression = static_cast<const IfExpression*>(node);
+        for (const auto& branch : ifExpression->Branches) {
+            count += countNodes(branch.first.get()) + countNodes(branch.second.get());
+        }
+        count += countNodes(ifExpression->Alternative.get());
+        break;
+    }
+    case NodeKind::WhileExpression: {
+        auto whileExpression = static_cast<const WhileExpression*>(node);
+        count += countNodes(whileExpression->Condition.get()) + countNodes(whileExpression->Body.get());
+        break;
+    }
+    case NodeKind::FunctionLiteral: {
+        auto function = static_cast<const FunctionLiteral*>(node);
+        count += countNodes(function->CallName.get()) + countAll(function->Parameters) + countNodes(function->Body.get());
+        break;
+    }
+    case NodeKind::CallExpression: {
+        auto call = static_cast<const CallExpression*>(node);
+        count += countNodes(call->Function.get()) + countAll(call->Arguments);
+        break;
+    }
+    case NodeKind::AssignExpression: {
+        auto assign = static_cast<const AssignExpression*>(node);
+        count += countAll(assign->names) + countNodes(assign->value.get());
+        break;
+    }
+    default: // Identifiers, literals and markers have no children
+        break;
+    }
+    return count;
+}
+
+// Points stdin at the start of the program's .in file, if it has one
+bool rewindInput(const std::filesystem::path& inputPath) {
+    if (!std::filesystem::exists(inputPath)) {
+        return true;
+    }
+
+    int fd = open(inputPath.string().c_str(), O_RDONLY);
+    if (fd < 0 || dup2(fd, 0) < 0) {
+        return false;
+    }
+    close(fd);
+    StandardInput().Reset();
+    return true;
+}
+
+bool run(const Options& options, const std::filesystem::path& path, Result& result) {
+    std::ifstream file(path, std::ios::binary);
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    const std::string text = buffer.str();
+    auto inputPath = std::filesystem::path(path).replace_extension(".in");
+
+    result.name = path.filename().string();
+    result.bytes = text.size();
+    SilenceCout silence;
+
+    auto newSource = [&] { return std::make_shared<Source>(text); };
+    measure(options, result.lexer, newSource, [&](const SourcePtr& source) {
+        Lexer lexer(source);
+        std::size_t tokens = 0;
+        while (lexer.NextToken().Type != EOF_TOKEN) {
+            ++tokens;
+        }
+        result.lexer.units = tokens;
+    });
+
+    // The parser is handed the file lexed beforehand, so this is parsing alone
+    auto lexSource = [&] {
+        Lexer lexer(newSource());
+        return TokenStream(lexer);
+    };
+    measure(options, result.parser, lexSource, [&](TokenStream& tokens) {
+        Parser parser(std::move(tokens));
+        auto program = parser.ParseProgram();
+        result.parser.units = countNodes(program.get());
+    });
+
+    // Only Eval is timed. Parsing and resolving a fresh program each run keeps
+    // the previous run's globals out of it.
+    for (int i = 0; i < options.warmup + options.repetitions; i++) {
+        Parser parser(std::make_unique<Lexer>(std::make_shared<Source>(text)));
+        auto program = parser.ParseProgram();
+        if (!parser.Errors().empty()) {
+            std::cerr << result.name << ": " << parser.Errors().front() << std::endl;
+            return false;
+        }
+        if (!rewindInput(inputPath)) {
+            std::cerr << result.name << ": could not open " << inputPath.string() << std::endl;
+            return false;
+        }
+
+        auto env = MakeRef<Environment>();
+        Resolver(*env).Resolve(program.get());
+
+        std::size_t before = CurrentRuntime().EvaluatedStatements;
+        auto start = Clock::now();
+        auto value = Eval(program.get(), env);
+        std::chrono::duration<double> elapsed = Clock::now() - start;
+        StandardOutput().Flush();
+
+        if (auto error = value.As<ErrorObject>()) {
+            std::cerr << result.name << ": " << error->Message << std::endl;
+            return false;
+        }
+        if (i >= options.warmup) {
+            result.evaluator.units = CurrentRuntime().EvaluatedStatements - before;
+            result.evaluator.seconds.push_back(elapsed.count());
+        }
+    }
+
+    // Only Run is timed, compiling is left out like resolving is above
+    result.vm.units = result.evaluator.units;
+    for (int i = 0; i < options.warmup + options.repetitions; i++) {
+        Parser parser(std::make_unique<Lexer>(std::make_shared<Source>(text)));
+        auto program = parser.ParseProgram();
+        Compiler compiler;
+        if (!compiler.Compile(program.get())) {
+            std::cerr << result.name << ": " << compiler.Errors().front() << std::endl;
+            return false;
+        }
+        if (!rewindInput(inputPath)) {
+            std::cerr << result.name << ": could not open " << inputPath.string() << std::endl;
+            return false;
+        }
+
+        VM vm(compiler.GetBytecode());
+        auto start = Clock::now();
+        vm.Run();
+        std::chrono::duration<double> elapsed = Clock::now() - start;
+        StandardOutput().Flush();
+
+        if (i >= options.warmup) {
+            result.vm.seconds.push_back(elapsed.count());
+        }
+    }
+    return true;
+}
+
+double megabytesPerSecond(const Result& result) {
+    return result.bytes / result.lexer.Median() / 1e6;
+}
+
+void printTable(const std::vector<Result>& results) {
+    auto row = [](const char* stage, const char* unit, const Measurement& m) {
+        std::cout << "  " << std::left << std::setw(10) << stage << std::right
+            << std::setw(10) << m.units << " " << std::left << std::setw(11) << unit << std::right
+            << std::fixed << std::setprecision(3)
+            << std::setw(10) << m.Median() * 1000 << " ms"
+            << std::setw(10) << m.P95() * 1000 << " ms"
+            << std::setprecision(0) << std::setw(14) << m.Rate() << " " << unit << "/s" << std::endl;
+    };
+
+    std::cout << "  stage          work              median         p95        throughput" << std::endl;
+    for (const auto& result : results) {
+        std::cout << result.name << std::endl;
+        row("lexer", "tokens", result.lexer);
+        std::cout << "  " << std::left << std::setw(10) << "" << std::right
+            << std::setw(10) << result.bytes << " " << std::left << std::setw(11) << "bytes" << std::right
+            << std::setw(40) << std::setprecision(1) << megabytesPerSecond(result) << " MB/s" << std::endl;
+        row("parser", "nodes", result.parser);
+        row("evaluator", "statements", result.evaluator);
+        row("vm", "statements", result.vm);
+    }
+    std::cout << "(scanning kernel " << ScanKernelName(CurrentScanKernel()) << ")" << std::endl;
+}
+
+void printJson(const Options& options, const std::vector<Result>& results) {
+    auto stage = [](const char* name, const char* unit, const Measurement& m, bool last) {
+        std::cout << "      \"" << name << "\": {\"" << unit << "\": " << m.units
+            << ", \"median_seconds\": " << m.Median()
+            << ", \"p95_seconds\": " << m.P95()
+            << ", \"" << unit << "_per_second\": " << m.Rate() << "}" << (last ? "" : ",") << "\n";
+    };
+
+    std::cout << std::setprecision(9);
+    std::cout << "{\n  \"scan_kernel\": \"" << ScanKernelName(CurrentScanKernel()) << "\",\n  \"warmup\": " << options.warmup << ",\n  \"repetitions\": " << options.repetitions
+        << ",\n  \"programs\": [\n";
+    for (std::size_t i = 0; i < results.size(); i++) {
+        const Result& result = results[i];
+        std::cout << "    {\n      \"name\": \"" << result.name << "\",\n"
+            << "      \"bytes\": " << result.bytes << ",\n"
+            << "      \"lexer_megabytes_per_second\": " << megabytesPerSecond(result) << ",\n";
+        stage("lexer", "tokens", result.lexer, false);
+        stage("parser", "nodes", result.parser, false);
+        stage("evaluator", "statements", result.evaluator, false);
+        stage("vm", "statements", result.vm, true);
+        std::cout << "    }" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    std::cout << "  ]\n}" << std::endl;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        if (!strncmp(argv[i], "--dir=", 6)) {
+            options.dir = argv[i] + 6;
+        }
+        else if (!strncmp(argv[i], "--warmup=", 9)) {
+            options.warmup = std::max(0, std::atoi(argv[i] + 9));
+        }
+        else if (!strncmp(argv[i], "--repetitions=", 14)) {
+            options.repetitions = std::max(1, std::atoi(argv[i] + 14));
+        }
+        else if (!strcmp(argv[i], "--json")) {
+            options.json = true;
+        }
+        else if (!strncmp(argv[i], "--scan=", 7)) {
+            bool found = false;
+            for (ScanKernel kernel : { ScanKernel::Scalar, ScanKernel::Sse2, ScanKernel::Avx2 }) {
+                if (ScanKernelName(kernel) == argv[i] + 7) {
+                    found = true;
+                    if (!SetScanKernel(kernel)) {
+                        std::cerr << "This processor can't run the " << argv[i] + 7 << " kernel" << std::endl;
+                        return EXIT_FAILURE;
+                    }
+                }
+            }
+            if (!found) {
+                std::cerr << "Unknown scanning kernel: " << argv[i] + 7 << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else {
+            std::cerr << "Usage: Benchmark [--dir=programs] [--warmup=3] [--repetitions=20] [--json] [--scan=scalar|sse2|avx2]" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::vector<std::filesystem::path> programs;
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(options.dir, error)) {
+        if (entry.path().extension() == ".code") {
+            programs.push_back(entry.path());
+        }
+    }
+    if (programs.empty()) {
+        std::cerr << "No .code programs in " << options.dir << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::sort(programs.begin(), programs.end());
+
+    std::FILE* discard = std::fopen(NULL_DEVICE, "w");
+    if (discard == nullptr) {
+        std::cerr << "Could not open " << NULL_DEVICE << std::endl;
+        return EXIT_FAILURE;
+    }
+    StandardOutput().SetPolicy(FlushPolicy::Block);
+    StandardOutput().SetSink(discard);
+
+    std::vector<Result> results;
+    for (const auto& path : programs) {
+        Result result;
+        if (!run(options, path, result)) {
+            return EXIT_FAILURE;
+        }
+        results.push_back(std::move(result));
+    }
+
+    if (options.json) {
+        printJson(options, results);
+    }
+    else {
+        printTable(results);
+    }
+    return 0;
+}
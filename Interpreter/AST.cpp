@@ -0,0 +1,11 @@
+#include "AST.h"
+#include "Object.h"
+
+StringLiteral::StringLiteral(const Token& token, std::string_view value, Ref<::String> constant)
+    : Expression(KindTag), token(token), Value(value), Constant(std::move(constant)) {}
+
+StringLiteral::~StringLiteral() = default;
+
+std::unique_ptr<Expression> StringLiteral::clone() const {
+    return std::make_unique<StringLiteral>(token, Value, Constant);
+}
@@ -5,30 +5,80 @@
 #include <memory>
 #include <iostream>
 #include "Token.h"
+#include "Source.h"
+#include "Ref.h"
+
+class String; // Object.h
+
+// Concrete type of a Node, so passes over the tree can switch on it instead
+// of trying a dynamic_cast per class
+enum class NodeKind : uint8_t {
+    Program,
+    Identifier,
+    TypedDeclStatement,
+    MultiTypedDeclStatement,
+    ReturnStatement,
+    ExpressionStatement,
+    IntegerLiteral,
+    StringLiteral,
+    FloatLiteral,
+    CharLiteral,
+    PrefixExpression,
+    InfixExpression,
+    Boolean,
+    BlockStatement,
+    IfExpression,
+    WhileExpression,
+    FunctionLiteral,
+    CallExpression,
+    AssignExpression,
+    MarkerStatement,
+};
 
 class Node {
 public:
+    const NodeKind Kind;
+
+    explicit Node(NodeKind kind) : Kind(kind) {}
     virtual ~Node() = default;
     virtual std::string TokenLiteral() const = 0;
     virtual std::string String() const = 0;
+
+    // The node as a T, or null if it is some other kind
+    template<typename T>
+    const T* As() const {
+        return Kind == T::KindTag ? static_cast<const T*>(this) : nullptr;
+    }
+
+    template<typename T>
+    T* As() {
+        return Kind == T::KindTag ? static_cast<T*>(this) : nullptr;
+    }
 };
 
 class Statement : public Node {
 public:
+    explicit Statement(NodeKind kind) : Node(kind) {}
     virtual void statementNode() = 0;
     virtual std::unique_ptr<Statement> clone() const = 0;
 };
 
 class Expression : public Node {
 public:
+    explicit Expression(NodeKind kind) : Node(kind) {}
     virtual void expressionNode() = 0;
     virtual std::unique_ptr<Expression> clone() const = 0;
 };
 
 class Program : public Node {
 public:
+    static constexpr NodeKind KindTag = NodeKind::Program;
+
+    SourcePtr Src; // Keeps the token literals alive, declared first so it goes last
     std::vector<std::unique_ptr<Statement>> Statements;
 
+    Program() : Node(KindTag) {}
+
     std::string TokenLiteral() const override {
         if (!Statements.empty()) {
             return Statements[0]->TokenLiteral();
@@ -49,51 +99,61 @@ public:
 
 class Identifier : public Expression {
 public:
+    static constexpr NodeKind KindTag = NodeKind::Identifier;
+
     Token token;
-    std::string Value;
+    std::string_view Value; // Points into the Source, like token.Literal
+
+    // Filled in by the Resolver: how many frames up the variable lives and its
+    // slot in that frame. Slot stays -1 for names that could not be resolved
+    // statically (REPL globals declared on a later line, builtins).
+    int Depth = -1;
+    int Slot = -1;
 
     Identifier(const Token& token)
-        : token(token) {}
+        : Expression(KindTag), token(token) {}
 
-    Identifier(const Token& token, const std::string& value)
-        : token(token), Value(value) {}
+    Identifier(const Token& token, std::string_view value)
+        : Expression(KindTag), token(token), Value(value) {}
 
-    std::string String() const override { return Value; }
+    std::string String() const override { return std::string(Value); }
 
     void expressionNode() override {}
-    std::string TokenLiteral() const override { return token.Literal; }
+    std::string TokenLiteral() const override { return std::string(token.Literal); }
 
     std::unique_ptr<Expression> clone() const override {
-        return std::make_unique<Identifier>(token, Value);
+        return std::make_unique<Identifier>(*this);
     }
 };
 
 // Subtree structure: <TYPE> <IDENT> <ASSIGN> <EXPRESSION>
 class TypedDeclStatement : public Statement {
 public:
-    Token token = {"NONE", ""}; // <TYPE>
+    static constexpr NodeKind KindTag = NodeKind::TypedDeclStatement;
+
+    Token token = {NONE, ""}; // <TYPE>
     std::unique_ptr<Identifier> Name; // <IDENT>
     std::unique_ptr<Expression> Value; // <EXPRESSION>
 
     TypedDeclStatement(const Token& token)
-        : token(token) {}
+        : Statement(KindTag), token(token) {}
 
     TypedDeclStatement(const Token& token, std::unique_ptr<Identifier> name)
-        : token(token), Name(std::move(name)) {}
+        : Statement(KindTag), token(token), Name(std::move(name)) {}
 
     //TypedDeclStatement(std::unique_ptr<Identifier> name, std::unique_ptr<Identifier> value)
     //    : Name(std::move(name)), Value(std::move(value)) {}
 
     TypedDeclStatement(const Token& token, std::unique_ptr<Identifier> name, std::unique_ptr<Identifier> value)
-        : token(token), Name(std::move(name)), Value(std::move(value)) {}
+        : Statement(KindTag), token(token), Name(std::move(name)), Value(std::move(value)) {}
 
     TypedDeclStatement(const Token& token, std::unique_ptr<Identifier> name, std::unique_ptr<Expression> value)
-        : token(token), Name(std::move(name)), Value(std::move(value)) {}
+        : Statement(KindTag), token(token), Name(std::move(name)), Value(std::move(value)) {}
 
     std::string String() const override {
         std::ostringstream out;
 
-        if (token.Type != "NONE") {
+        if (token.Type != NONE) {
             out << TokenLiteral();
         }
 
@@ -109,7 +169,7 @@ public:
     }
 
     void statementNode() override {}
-    std::string TokenLiteral() const override { return token.Literal; }
+    std::string TokenLiteral() const override { return std::string(token.Literal); }
 
     std::unique_ptr<Statement> clone() const override {
         auto nameClone = std::make_unique<Identifier>(*Name);
@@ -120,23 +180,25 @@ public:
 
 class MultiTypedDeclStatement : public Statement {
 public:
-    Token token = { "NONE", "" }; // <TYPE>
+    static constexpr NodeKind KindTag = NodeKind::MultiTypedDeclStatement;
+
+    Token token = { NONE, "" }; // <TYPE>
     std::vector<std::unique_ptr<Identifier>> Names; // <IDENTS>
     std::vector<std::unique_ptr<Expression>> Values; // <EXPRESSIONS>
 
     MultiTypedDeclStatement(const Token& token)
-        : token(token) {}
+        : Statement(KindTag), token(token) {}
 
     MultiTypedDeclStatement(const Token& token, std::vector<std::unique_ptr<Identifier>> names)
-        : token(token), Names(std::move(names)) {}
+        : Statement(KindTag), token(token), Names(std::move(names)) {}
 
     MultiTypedDeclStatement(const Token& token, std::vector<std::unique_ptr<Identifier>> names, std::vector<std::unique_ptr<Expression>> values)
-        : token(token), Names(std::move(names)), Values(std::move(values)) {}
+        : Statement(KindTag), token(token), Names(std::move(names)), Values(std::move(values)) {}
 
     std::string String() const override {
         std::ostringstream out;
 
-        if (token.Type != "NONE") {
+        if (token.Type != NONE) {
             out << TokenLiteral();
         }
 
@@ -161,7 +223,7 @@ public:
     }
 
     void statementNode() override {}
-    std::string TokenLiteral() const override { return token.Literal; }
+    std::string TokenLiteral() const override { return std::string(token.Literal); }
 
     std::unique_ptr<Statement> clone() const override {
         std::vector<std::unique_ptr<Identifier>> namesClones;
@@ -187,14 +249,16 @@ public:
 // Subtree structure: <RETURN> <EXPRESSION>
 class ReturnStatement : public Statement {
 public:
+    static constexpr NodeKind KindTag = NodeKind::ReturnStatement;
+
     Token token; // <RETURN>
     std::unique_ptr<Expression> ReturnValue; // <EXPRESSION>
 
     ReturnStatement(const Token& token)
-        : token(token) {}
+        : Statement(KindTag), token(token) {}
 
     ReturnStatement(const Token& token, std::unique_ptr<Expression> returnValue)
-        : token(token), ReturnValue(std::move(returnValue)) {}
+        : Statement(KindTag), token(token), ReturnValue(std::move(returnValue)) {}
 
     std::string String() const override {
         std::ostringstream out;
@@ -209,7 +273,7 @@ public:
     }
 
     void statementNode() override {}
-    std::string TokenLiteral() const override { return token.Literal; }
+    std::string TokenLiteral() const override { return std::string(token.Literal); }
 
     std::unique_ptr<Statement> clone() const override {
         auto returnValueClone = ReturnValue ? std::unique_ptr<Expression>(static_cast<Expression*>(ReturnValue->clone().release())) : nullptr;
@@ -220,12 +284,14 @@ public:
 // Subtree structure: <EXPRESSION> ... <EXPRESSION> 
 class ExpressionStatement : public Statement {
 public:
-    Token token = {"NONE", ""}; // <First token of the expression>
+    static constexpr NodeKind KindTag = NodeKind::ExpressionStatement;
+
+    Token token = {NONE, ""}; // <First token of the expression>
     std::unique_ptr<Expression> name;
     std::unique_ptr<Expression> Expression_; // <EXPRESSION>
 
     ExpressionStatement(const Token& token)
-        : token(token) {}
+        : Statement(KindTag), token(token) {}
 
     std::string String() const override {
         std::ostringstream out;
@@ -245,7 +311,7 @@ public:
     }
 
     void statementNode() override {}
-    std::string TokenLiteral() const override { return token.Literal; }
+    std::string TokenLiteral() const override { return std::string(token.Literal); }
 
     std::unique_ptr<Statement> clone() const override {
         if (!Expression_) { 
@@ -267,19 +333,21 @@ public:
 // Subtree structure: <EXPRESSION>
 class IntegerLiteral : public Expression {
 public:
+    static constexpr NodeKind KindTag = NodeKind::IntegerLiteral;
+
     Token token; 
     int Value = 0; //  Default value = 0;
 
     IntegerLiteral(const Token& token)
-        : token(token) {}
+        : Expression(KindTag), token(token) {}
 
     IntegerLiteral(const Token& token, const int value)
-        : token(token), Value(value) {}
+        : Expression(KindTag), token(token), Value(value) {}
 
-    std::string String() const override { return token.Literal; }
+    std::string String() const override { return std::string(token.Literal); }
 
     void expressionNode() override {}
-    std::string TokenLiteral() const override { return token.Literal; }
+    std::string TokenLiteral() const override { return std::string(token.Literal); }
 
     std::unique_ptr<Expression> clone() const override {
         return std::make_unique<IntegerLiteral>(token, Value);
@@ -289,34 +357,40 @@ public:
 // Subtree structure: <EXPRESSION>
 class StringLiteral : public Expression {
 public:
+    static constexpr NodeKind KindTag = NodeKind::StringLiteral;
+
     Token token;
-    std::string Value;
+    std::string_view Value; // Points into the Source, like token.Literal
+    // Built once by the parser and handed out on every evaluation, strings
+    // are never modified in place
+    Ref<::String> Constant;
 
-    StringLiteral(const Token& token, const std::string& value)
-        : token(token), Value(value) {}
+    // Defined in AST.cpp, holding a Ref needs the complete String
+    StringLiteral(const Token& token, std::string_view value, Ref<::String> constant);
+    ~StringLiteral() override;
 
-    std::string String() const override { return "\"" + Value + "\""; }
+    std::string String() const override { return "\"" + std::string(Value) + "\""; }
 
     void expressionNode() override {}
-    std::string TokenLiteral() const override { return token.Literal; }
+    std::string TokenLiteral() const override { return std::string(token.Literal); }
 
-    std::unique_ptr<Expression> clone() const override {
-        return std::make_unique<StringLiteral>(token, Value);
-    }
+    std::unique_ptr<Expression> clone() const override;
 };
 
 class FloatLiteral : public Expression {
 public:
+    static constexpr NodeKind KindTag = NodeKind::FloatLiteral;
+
     Token token;
     double Value = 0.0;
 
     FloatLiteral(const Token& token, double value)
-        : token(token), Value(value) {}
+        : Expression(KindTag), token(token), Value(value) {}
 
-    std::string String() const override { return token.Literal; }
+    std::string String() const override { return std::string(token.Literal); }
 
     void expressionNode() override {}
-    std::string TokenLiteral() const override { return token.Literal; }
+    std::string TokenLiteral() const override { return std::string(token.Literal); }
 
     std::unique_ptr<Expression> clone() const override {
         return std::make_unique<FloatLiteral>(token, Value);
@@ -326,16 +400,18 @@ public:
 // Subtree structure: <EXPRESSION>
 class CharLiteral : public Expression {
 public:
+    static constexpr NodeKind KindTag = NodeKind::CharLiteral;
+
     Token token;
     char Value; // Changed from std::string to char to represent a CHAR
 
     CharLiteral(const Token& token, char value)
-        : token(token), Value(value) {}
+        : Expression(KindTag), token(token), Value(value) {}
 
     std::string String() const override { return "'" + std::string(1, Value) + "'"; } // Adjusted for char
 
     void expressionNode() override {}
-    std::string TokenLiteral() const override { return token.Literal; }
+    std::string TokenLiteral() const override { return std::string(token.Literal); }
 
     std::unique_ptr<Expression> clone() const override {
         return std::make_unique<CharLiteral>(token, Value);
@@ -346,12 +422,14 @@ public:
 // Subtree structure: <prefix operator><EXPRESSION>;
 class PrefixExpression : public Expression {
 public:
+    static constexpr NodeKind KindTag = NodeKind::PrefixExpression;
+
     Token token;
-    std::string Operator;
+    std::string_view Operator;
     std::unique_ptr<Expression> Right;
 
-    PrefixExpression(const Token& token, const std::string Operator)
-        : token(token), Operator(Operator) {}
+    PrefixExpression(const Token& token, std::string_view Operator)
+        : Expression(KindTag), token(token), Operator(Operator) {}
 
     std::string String() const override {
         std::ostringstream out;
@@ -365,7 +443,7 @@ public:
     }
 
     void expressionNode() override {}
-    std::string TokenLiteral() const override { return token.Literal; }
+    std::string TokenLiteral() const override { return std::string(token.Literal); }
 
     std::unique_ptr<Expression> clone() const override {
         auto clonedRight = std::unique_ptr<Expression>(static_cast<Expression*>(Right->clone().release()));
@@ -377,16 +455,18 @@ public:
 
 class InfixExpression : public Expression {
 public:
+    static constexpr NodeKind KindTag = NodeKind::InfixExpression;
+
     Token token;
     std::unique_ptr<Expression> Left;
-    std::string Operator;
+    std::string_view Operator;
     std::unique_ptr<Expression> Right;
 
-    InfixExpression(const Token& token, std::unique_ptr<Expression> left, const std::string& op, std::unique_ptr<Expression> right)
-        : token(token), Left(std::move(left)), Operator(op), Right(std::move(right)) {}
+    InfixExpression(const Token& token, std::unique_ptr<Expression> left, std::string_view op, std::unique_ptr<Expression> right)
+        : Expression(KindTag), token(token), Left(std::move(left)), Operator(op), Right(std::move(right)) {}
 
     std::string TokenLiteral() const override {
-        return token.Literal;
+        return std::string(token.Literal);
     }
 
     std::string String() const override {
@@ -430,23 +510,25 @@ public:
 
 class Boolean : public Expression {
 public:
+    static constexpr NodeKind KindTag = NodeKind::Boolean;
+
     Token token; 
     bool Value = true; // Default value = true  
 
     Boolean(const Token& token)
-        : token(token) {}
+        : Expression(KindTag), token(token) {}
 
     Boolean(const Token& token, bool value)
-        : token(token), Value(value) {}
+        : Expression(KindTag), token(token), Value(value) {}
 
     void expressionNode() override {}
 
     std::string TokenLiteral() const override {
-        return token.Literal;
+        return std::string(token.Literal);
     }
 
     std::string String() const override {
-        return token.Literal; 
+        return std::string(token.Literal); 
     }
 
     std::unique_ptr<Expression> clone() const override {
@@ -456,15 +538,17 @@ public:
 
 class BlockStatement : public Statement {
 public:
+    static constexpr NodeKind KindTag = NodeKind::BlockStatement;
+
     Token token; 
     std::vector<std::unique_ptr<Statement>> Statements;
 
-    BlockStatement(const Token& tok) : token(tok) {}
+    BlockStatement(const Token& tok) : Statement(KindTag), token(tok) {}
 
     void statementNode() override {}
 
     std::string TokenLiteral() const override {
-        return token.Literal;
+        return std::string(token.Literal);
     }
 
     std::string String() const override {
@@ -496,7 +580,7 @@ public:
 //    void expressionNode() override {}
 //
 //    std::string TokenLiteral() const override {
-//        return token.Literal;
+//        return std::string(token.Literal);
 //    }
 //
 //    std::string String() const override {
@@ -530,17 +614,19 @@ public:
 
 class IfExpression : public Expression {
 public:
+    static constexpr NodeKind KindTag = NodeKind::IfExpression;
+
     Token token;
     // Using 'Branches' to represent the conditional execution paths
     std::vector<std::pair<std::unique_ptr<Expression>, std::unique_ptr<BlockStatement>>> Branches;
     std::unique_ptr<BlockStatement> Alternative;
 
-    IfExpression(const Token& tok) : token(tok) {}
+    IfExpression(const Token& tok) : Expression(KindTag), token(tok) {}
 
     void expressionNode() override {}
 
     std::string TokenLiteral() const override {
-        return token.Literal;
+        return std::string(token.Literal);
     }
 
     std::string String() const override {
@@ -586,16 +672,19 @@ public:
 
 class WhileExpression : public Expression {
 public:
+    static constexpr NodeKind KindTag = NodeKind::WhileExpression;
+
     Token token;
     std::unique_ptr<Expression> Condition;
     std::unique_ptr<BlockStatement> Body;
+    int NumSlots = 0; // Frame size of one iteration, set by the Resolver
 
-    WhileExpression(const Token& tok) : token(tok) {}
+    WhileExpression(const Token& tok) : Expression(KindTag), token(tok) {}
 
     void expressionNode() override {}
 
     std::string TokenLiteral() const override {
-        return token.Literal;
+        return std::string(token.Literal);
     }
 
     std::string String() const override {
@@ -615,6 +704,7 @@ public:
         auto clonedWhileExpr = std::make_unique<WhileExpression>(token);
         clonedWhileExpr->Condition = std::move(clonedCondition);
         clonedWhileExpr->Body = std::move(clonedBody);
+        clonedWhileExpr->NumSlots = NumSlots;
 
         return clonedWhileExpr;
     }
@@ -622,23 +712,27 @@ public:
 
 class FunctionLiteral : public Expression {
 public:
+    static constexpr NodeKind KindTag = NodeKind::FunctionLiteral;
+
     Token token;
     Token type;
+    SourcePtr Src; // Keeps the tokens alive after the Program is gone
     std::unique_ptr<Expression> CallName;
     std::vector<std::unique_ptr<TypedDeclStatement>> Parameters;
     std::unique_ptr<BlockStatement> Body;
+    int NumSlots = 0; // Frame size of a call, set by the Resolver
 
-    FunctionLiteral(const Token& tok) : token(tok) {}
+    FunctionLiteral(const Token& tok) : Expression(KindTag), token(tok) {}
 
-    FunctionLiteral(const Token& tok, const Token& type) : token(tok), type(type) {}
+    FunctionLiteral(const Token& tok, const Token& type) : Expression(KindTag), token(tok), type(type) {}
 
     FunctionLiteral(const Token& tok, const Token& typ, std::unique_ptr<Expression> callName, std::vector<std::unique_ptr<TypedDeclStatement>>&& params, std::unique_ptr<BlockStatement>&& body)
-        : token(tok), type(typ), CallName(std::move(callName)), Parameters(std::move(params)), Body(std::move(body)) {}
+        : Expression(KindTag), token(tok), type(typ), CallName(std::move(callName)), Parameters(std::move(params)), Body(std::move(body)) {}
 
     void expressionNode() override {}
 
     std::string TokenLiteral() const override {
-        return token.Literal;
+        return std::string(token.Literal);
     }
 
     std::string String() const override {
@@ -672,22 +766,27 @@ public:
         auto clonedBody = std::unique_ptr<BlockStatement>(static_cast<BlockStatement*>(Body->clone().release()));
         auto clonedCallName = CallName ? std::unique_ptr<Expression>(static_cast<Expression*>(CallName->clone().release())) : nullptr;
 
-        return std::make_unique<FunctionLiteral>(token, type, std::move(clonedCallName), std::move(clonedParams), std::move(clonedBody));
+        auto clonedLit = std::make_unique<FunctionLiteral>(token, type, std::move(clonedCallName), std::move(clonedParams), std::move(clonedBody));
+        clonedLit->Src = Src;
+        clonedLit->NumSlots = NumSlots;
+        return clonedLit;
     }
 };
 
 class CallExpression : public Expression {
 public:
+    static constexpr NodeKind KindTag = NodeKind::CallExpression;
+
     Token token;
     std::unique_ptr<Expression> Function; // Can be Identifier or FunctionLiteral
     std::vector<std::unique_ptr<Expression>> Arguments;
 
-    CallExpression(const Token& tok) : token(tok) {}
+    CallExpression(const Token& tok) : Expression(KindTag), token(tok) {}
 
     void expressionNode() override {}
 
     std::string TokenLiteral() const override {
-        return token.Literal;
+        return std::string(token.Literal);
     }
 
     std::string String() const override {
@@ -727,10 +826,12 @@ public:
 
 class AssignExpression : public Expression {
 public:
+    static constexpr NodeKind KindTag = NodeKind::AssignExpression;
+
     std::vector<std::unique_ptr<Expression>> names;
     std::unique_ptr<Expression> value;
 
-    AssignExpression() {}
+    AssignExpression() : Expression(KindTag) {}
 
     void addName(std::unique_ptr<Expression> name) {
         names.push_back(std::move(name));
@@ -769,10 +870,12 @@ public:
 
 class MarkerStatement : public Statement {
 public:
+    static constexpr NodeKind KindTag = NodeKind::MarkerStatement;
+
     Token token;
     Token codeToken;
 
-    MarkerStatement(Token token, Token codeToken) : token(token), codeToken(codeToken) {}
+    MarkerStatement(Token token, Token codeToken) : Statement(KindTag), token(token), codeToken(codeToken) {}
 
     std::string String() const override {
         std::ostringstream out;
@@ -783,7 +886,7 @@ public:
     }
 
     void statementNode() override {}
-    std::string TokenLiteral() const override { return token.Literal; }
+    std::string TokenLiteral() const override { return std::string(token.Literal); }
 
     std::unique_ptr<Statement> clone() const override {
         return std::make_unique<MarkerStatement>(token, codeToken);
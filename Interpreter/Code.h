@@ -0,0 +1,193 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <sstream>
+#include <vector>
+#include <iomanip>
+#include <initializer_list>
+#include "Token.h"
+
+// Bytecode Definition
+using Instructions = std::vector<uint8_t>;
+
+enum class OpCode : uint8_t {
+    OpConstant,       // <const index: 4>
+    OpPop,
+    OpAdd,
+    OpSub,
+    OpMul,
+    OpDiv,
+    OpConcat,         // &
+    OpTrue,
+    OpFalse,
+    OpNull,
+    OpEqual,
+    OpNotEqual,
+    OpLessThan,
+    OpGreaterThan,
+    OpMinus,
+    OpBang,
+    OpJumpNotTruthy,  // <target: 4>
+    OpJump,           // <target: 4>
+    OpGetGlobal,      // <global index: 2>
+    OpDeclareGlobal,  // <global index: 2> <type: 1> <mode: 1>
+    OpAssignGlobal,   // <global index: 2>
+    OpGetLocal,       // <local index: 2>
+    OpDeclareLocal,   // <local index: 2> <type: 1> <mode: 1>
+    OpAssignLocal,    // <local index: 2>
+    OpClearLocals,    // <first local: 2> <count: 2>
+    OpGetFree,        // <free index: 1>
+    OpDeclareFree,    // <free index: 1> <type: 1> <mode: 1>
+    OpAssignFree,     // <free index: 1>
+    OpCurrentClosure,
+    OpClosure,        // <const index: 4>
+    OpCall,           // <arg count: 1>
+    OpReturnValue,
+    OpReturn,
+    OpScanGlobal,     // <global index: 2>
+    OpScanLocal,      // <local index: 2>
+    OpScanFree,       // <free index: 1>
+    OpRaise,          // <const index: 4>
+};
+
+// How OpDeclare* treats a value whose type does not match the declaration
+enum class DeclareMode : uint8_t {
+    Checked,   // INT x = ...     -> error
+    Lenient,   // INT x, y = ... -> log the mismatch and skip the variable
+    Unchecked, // INT x / FUNCTION f = ... -> store as is
+};
+
+// Declared types travel in the bytecode as a one-byte index into this table
+inline const std::vector<TokenType>& DeclaredTypes() {
+    static const std::vector<TokenType> types = { FUNCTION, INT, CHAR, BOOL, FLOAT, STRING, VOID };
+    return types;
+}
+
+inline uint8_t DeclaredTypeIndex(const TokenType& type) {
+    const auto& types = DeclaredTypes();
+    for (size_t i = 0; i < types.size(); ++i) {
+        if (types[i] == type) return static_cast<uint8_t>(i);
+    }
+    return 0;
+}
+
+struct Definition {
+    std::string Name;
+    std::vector<int> OperandWidths;
+};
+
+inline const Definition& Lookup(OpCode op) {
+    static const std::vector<Definition> definitions = {
+        {"OpConstant", {4}},
+        {"OpPop", {}},
+        {"OpAdd", {}},
+        {"OpSub", {}},
+        {"OpMul", {}},
+        {"OpDiv", {}},
+        {"OpConcat", {}},
+        {"OpTrue", {}},
+        {"OpFalse", {}},
+        {"OpNull", {}},
+        {"OpEqual", {}},
+        {"OpNotEqual", {}},
+        {"OpLessThan", {}},
+        {"OpGreaterThan", {}},
+        {"OpMinus", {}},
+        {"OpBang", {}},
+        {"OpJumpNotTruthy", {4}},
+        {"OpJump", {4}},
+        {"OpGetGlobal", {2}},
+        {"OpDeclareGlobal", {2, 1, 1}},
+        {"OpAssignGlobal", {2}},
+        {"OpGetLocal", {2}},
+        {"OpDeclareLocal", {2, 1, 1}},
+        {"OpAssignLocal", {2}},
+        {"OpClearLocals", {2, 2}},
+        {"OpGetFree", {1}},
+        {"OpDeclareFree", {1, 1, 1}},
+        {"OpAssignFree", {1}},
+        {"OpCurrentClosure", {}},
+        {"OpClosure", {4}},
+        {"OpCall", {1}},
+        {"OpReturnValue", {}},
+        {"OpReturn", {}},
+        {"OpScanGlobal", {2}},
+        {"OpScanLocal", {2}},
+        {"OpScanFree", {1}},
+        {"OpRaise", {4}},
+    };
+    return definitions[static_cast<size_t>(op)];
+}
+
+// Operands are stored big-endian
+inline uint16_t ReadUint16(const uint8_t* ins) {
+    return static_cast<uint16_t>((ins[0] << 8) | ins[1]);
+}
+
+inline uint32_t ReadUint32(const uint8_t* ins) {
+    return (static_cast<uint32_t>(ins[0]) << 24) | (static_cast<uint32_t>(ins[1]) << 16) |
+        (static_cast<uint32_t>(ins[2]) << 8) | static_cast<uint32_t>(ins[3]);
+}
+
+inline void PutOperand(uint8_t* ins, int width, uint32_t operand) {
+    for (int i = width - 1; i >= 0; --i) {
+        ins[i] = static_cast<uint8_t>(operand & 0xFF);
+        operand >>= 8;
+    }
+}
+
+inline Instructions Make(OpCode op, std::initializer_list<uint32_t> operands = {}) {
+    const Definition& def = Lookup(op);
+
+    size_t length = 1;
+    for (int w : def.OperandWidths) {
+        length += w;
+    }
+
+    Instructions instruction(length);
+    instruction[0] = static_cast<uint8_t>(op);
+
+    size_t offset = 1;
+    size_t i = 0;
+    for (uint32_t operand : operands) {
+        if (i >= def.OperandWidths.size()) break;
+        int width = def.OperandWidths[i++];
+        PutOperand(&instruction[offset], width, operand);
+        offset += width;
+    }
+
+    return instruction;
+}
+
+inline uint32_t ReadOperand(const uint8_t* ins, int width) {
+    switch (width) {
+    case 1: return ins[0];
+    case 2: return ReadUint16(ins);
+    case 4: return ReadUint32(ins);
+    }
+    return 0;
+}
+
+// Disassembler, used by tests and for debugging the compiler output
+inline std::string InstructionsString(const Instructions& ins) {
+    std::ostringstream out;
+
+    size_t i = 0;
+    while (i < ins.size()) {
+        const Definition& def = Lookup(static_cast<OpCode>(ins[i]));
+
+        out << std::setw(4) << std::setfill('0') << i << " " << def.Name;
+
+        size_t offset = i + 1;
+        for (int w : def.OperandWidths) {
+            out << " " << ReadOperand(&ins[offset], w);
+            offset += w;
+        }
+        out << "\n";
+
+        i = offset;
+    }
+
+    return out.str();
+}
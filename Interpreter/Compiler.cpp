@@ -0,0 +1,733 @@
+#include "Compiler.h"
+#include "Evaluator.h"
+
+#include <algorithm>
+
+Compiler::Compiler() : symbolTable(std::make_shared<SymbolTable>()) {
+    scopes.push_back(CompilationScope{});
+}
+
+std::vector<std::string> Compiler::Errors() const {
+    return errors;
+}
+
+Bytecode Compiler::GetBytecode() const {
+    Bytecode bytecode;
+    bytecode.Instructions_ = scopes.back().Instructions_;
+    bytecode.Constants = constants;
+    bytecode.NumGlobals = symbolTable->NumDefinitions;
+    bytecode.NumLocals = symbolTable->NumLocals;
+    bytecode.GlobalNames = symbolTable->GlobalNames;
+    bytecode.LocalNames = symbolTable->LocalNames;
+    bytecode.StatementStarts = statementStarts;
+    bytecode.MaxStack = scopes.back().MaxDepth;
+    return bytecode;
+}
+
+bool Compiler::Compile(const Node* node) {
+    if (node == nullptr) {
+        // Failed parses leave holes in the tree, Eval treats them as no value
+        emit(OpCode::OpNull);
+        return true;
+    }
+
+    switch (node->Kind) {
+    case NodeKind::Program: {
+        auto program = static_cast<const Program*>(node);
+        declareStatements(program->Statements);
+        for (const auto& stmt : program->Statements) {
+            if (!stmt) {
+                continue;
+            }
+            statementStarts.push_back(currentInstructions().size());
+            if (!Compile(stmt.get())) {
+                return false;
+            }
+        }
+        // Operands that don't fit their instruction are only reported
+        return errors.empty();
+    }
+    case NodeKind::MarkerStatement:
+        // BEGIN CODE / END CODE, nothing to run
+        break;
+    case NodeKind::ExpressionStatement: {
+        auto exprStmt = static_cast<const ExpressionStatement*>(node);
+        if (!exprStmt->Expression_) {
+            return true;
+        }
+        if (!Compile(exprStmt->Expression_.get())) {
+            return false;
+        }
+        if (exprStmt->token.Type == FUNCTION && exprStmt->name) {
+            // FUNCTION name = <expression>
+            Symbol symbol = resolveForDeclare(exprStmt->name->TokenLiteral());
+            emitDeclare(symbol, FUNCTION, DeclareMode::Unchecked);
+        }
+        else {
+            emit(OpCode::OpPop);
+        }
+        break;
+    }
+    case NodeKind::BlockStatement:
+        return compileStatements(static_cast<const BlockStatement*>(node)->Statements);
+    case NodeKind::IntegerLiteral: {
+        auto intLit = static_cast<const IntegerLiteral*>(node);
+        emit(OpCode::OpConstant, { static_cast<uint32_t>(addConstant(Value::Integer(intLit->Value))) });
+        break;
+    }
+    case NodeKind::FloatLiteral: {
+        auto floatLit = static_cast<const FloatLiteral*>(node);
+        emit(OpCode::OpConstant, { static_cast<uint32_t>(addConstant(Value::Float(floatLit->Value))) });
+        break;
+    }
+    case NodeKind::StringLiteral: {
+        auto str = static_cast<const StringLiteral*>(node);
+        emit(OpCode::OpConstant, { static_cast<uint32_t>(addConstant(str->Constant)) });
+        break;
+    }
+    case NodeKind::CharLiteral: {
+        auto ch = static_cast<const CharLiteral*>(node);
+        emit(OpCode::OpConstant, { static_cast<uint32_t>(addConstant(Value::Char(ch->Value))) });
+        break;
+    }
+    case NodeKind::Boolean: {
+        auto bl = static_cast<const Boolean*>(node);
+        emit(bl->Value ? OpCode::OpTrue : OpCode::OpFalse);
+        break;
+    }
+    case NodeKind::PrefixExpression: {
+        auto prefixExpr = static_cast<const PrefixExpression*>(node);
+        if (!Compile(prefixExpr->Right.get())) {
+            return false;
+        }
+        if (prefixExpr->Operator == "!") {
+            emit(OpCode::OpBang);
+        }
+        else if (prefixExpr->Operator == "-") {
+            emit(OpCode::OpMinus);
+        }
+        else {
+            errors.push_back("unknown operator " + std::string(prefixExpr->Operator));
+            return false;
+        }
+        break;
+    }
+    case NodeKind::InfixExpression: {
+        auto infixExpr = static_cast<const InfixExpression*>(node);
+        if (!Compile(infixExpr->Left.get()) || !Compile(infixExpr->Right.get())) {
+            return false;
+        }
+
+        std::string_view op = infixExpr->Operator;
+        if (op == "+") emit(OpCode::OpAdd);
+        else if (op == "-") emit(OpCode::OpSub);
+        else if (op == "*") emit(OpCode::OpMul);
+        else if (op == "/") emit(OpCode::OpDiv);
+        else if (op == "&") emit(OpCode::OpConcat);
+        else if (op == "==") emit(OpCode::OpEqual);
+        else if (op == "<>") emit(OpCode::OpNotEqual);
+        else if (op == "<") emit(OpCode::OpLessThan);
+        else if (op == ">") emit(OpCode::OpGreaterThan);
+        else {
+            errors.push_back("unknown operator " + std::string(op));
+            return false;
+        }
+        break;
+    }
+    case NodeKind::IfExpression: {
+        auto ifExpr = static_cast<const IfExpression*>(node);
+        std::vector<size_t> jumpsToEnd;
+        int depth = scopes.back().Depth;
+
+        for (const auto& branch : ifExpr->Branches) {
+            if (!Compile(branch.first.get())) {
+                return false;
+            }
+            size_t jumpNotTruthyPos = emit(OpCode::OpJumpNotTruthy, { 9999 });
+
+            if (!compileBlockValue(branch.second.get())) {
+                return false;
+            }
+            jumpsToEnd.push_back(emit(OpCode::OpJump, { 9999 }));
+            scopes.back().Depth = depth; // The next branch starts without this one's value
+
+            changeOperand(jumpNotTruthyPos, { static_cast<uint32_t>(currentInstructions().size()) });
+        }
+
+        if (ifExpr->Alternative) {
+            if (!compileBlockValue(ifExpr->Alternative.get())) {
+                return false;
+            }
+        }
+        else {
+            emit(OpCode::OpNull);
+        }
+
+        for (size_t pos : jumpsToEnd) {
+            changeOperand(pos, { static_cast<uint32_t>(currentInstructions().size()) });
+        }
+        break;
+    }
+    case NodeKind::WhileExpression: {
+        auto whileExpr = static_cast<const WhileExpression*>(node);
+        int firstLocal = enterBlock();
+        declareStatement(whileExpr->Body.get());
+
+        // Every iteration starts with an empty loop scope, like the fresh loopEnv in evalWhileExpression
+        size_t loopStart = currentInstructions().size();
+        size_t clearPos = emit(OpCode::OpClearLocals, { 0, 0 });
+        scopes.back().LoopStarts.push_back(loopStart);
+
+        if (!Compile(whileExpr->Condition.get())) {
+            return false;
+        }
+        size_t jumpNotTruthyPos = emit(OpCode::OpJumpNotTruthy, { 9999 });
+
+        if (whileExpr->Body && !compileStatements(whileExpr->Body->Statements)) {
+            return false;
+        }
+        emit(OpCode::OpJump, { static_cast<uint32_t>(loopStart) });
+
+        changeOperand(jumpNotTruthyPos, { static_cast<uint32_t>(currentInstructions().size()) });
+        emit(OpCode::OpNull);
+
+        scopes.back().LoopStarts.pop_back();
+        leaveBlock(clearPos, firstLocal);
+        break;
+    }
+    case NodeKind::ReturnStatement: {
+        auto returnStmt = static_cast<const ReturnStatement*>(node);
+        if (!Compile(returnStmt->ReturnValue.get())) {
+            return false;
+        }
+        if (!scopes.back().LoopStarts.empty()) {
+            // evalWhileExpression only stops on errors, so a RETURN inside a loop body
+            // just ends the current iteration
+            emit(OpCode::OpPop);
+            emit(OpCode::OpJump, { static_cast<uint32_t>(scopes.back().LoopStarts.back()) });
+        }
+        else {
+            emit(OpCode::OpReturnValue);
+        }
+        break;
+    }
+    case NodeKind::MultiTypedDeclStatement: {
+        auto multiStmt = static_cast<const MultiTypedDeclStatement*>(node);
+        for (size_t i = 0; i < multiStmt->Names.size(); ++i) {
+            if (!multiStmt->Names[i]) {
+                continue;
+            }
+            const Expression* value = i < multiStmt->Values.size() ? multiStmt->Values[i].get() : nullptr;
+            if (!compileDeclaration(std::string(multiStmt->Names[i]->Value), multiStmt->token.Type, value, DeclareMode::Lenient)) {
+                return false;
+            }
+        }
+        break;
+    }
+    case NodeKind::TypedDeclStatement: {
+        auto typedDeclStmt = static_cast<const TypedDeclStatement*>(node);
+        return compileDeclaration(std::string(typedDeclStmt->Name->Value), typedDeclStmt->token.Type, typedDeclStmt->Value.get(), DeclareMode::Checked);
+    }
+    case NodeKind::Identifier: {
+        auto ident = static_cast<const Identifier*>(node);
+        compileIdentifier(std::string(ident->Value));
+        break;
+    }
+    case NodeKind::FunctionLiteral:
+        return compileFunctionLiteral(static_cast<const FunctionLiteral*>(node));
+    case NodeKind::CallExpression:
+        return compileCallExpression(static_cast<const CallExpression*>(node));
+    case NodeKind::AssignExpression:
+        return compileAssignExpression(static_cast<const AssignExpression*>(node));
+    default:
+        errors.push_back("cannot compile node " + node->String());
+        return false;
+    }
+
+    return true;
+}
+
+// Gives every name a scope declares its variable before any of the scope is
+// compiled, the same pass the Resolver makes. A use further up then reads the
+// scope's own variable, still unset, instead of falling through to a global.
+void Compiler::declareStatements(const std::vector<std::unique_ptr<Statement>>& statements) {
+    for (const auto& stmt : statements) {
+        declareStatement(stmt.get());
+    }
+}
+
+void Compiler::declareStatement(const Statement* stmt) {
+    if (stmt == nullptr) {
+        return;
+    }
+
+    switch (stmt->Kind) {
+    case NodeKind::TypedDeclStatement: {
+        auto decl = static_cast<const TypedDeclStatement*>(stmt);
+        if (decl->Name) {
+            resolveForDeclare(std::string(decl->Name->Value));
+        }
+        break;
+    }
+    case NodeKind::MultiTypedDeclStatement:
+        for (const auto& name : static_cast<const MultiTypedDeclStatement*>(stmt)->Names) {
+            if (name) {
+                resolveForDeclare(std::string(name->Value));
+            }
+        }
+        break;
+    case NodeKind::ExpressionStatement: {
+        auto exprStmt = static_cast<const ExpressionStatement*>(stmt);
+        if (exprStmt->token.Type == FUNCTION && exprStmt->name) {
+            resolveForDeclare(exprStmt->name->TokenLiteral());
+        }
+        const Expression* expr = exprStmt->Expression_.get();
+        if (auto fn = expr ? expr->As<FunctionLiteral>() : nullptr) {
+            if (fn->CallName) {
+                resolveForDeclare(fn->CallName->TokenLiteral());
+            }
+        }
+        else if (auto ifExpr = expr ? expr->As<IfExpression>() : nullptr) {
+            // IF blocks declare into the scope they appear in
+            for (const auto& branch : ifExpr->Branches) {
+                declareStatement(branch.second.get());
+            }
+            declareStatement(ifExpr->Alternative.get());
+        }
+        break;
+    }
+    case NodeKind::BlockStatement:
+        declareStatements(static_cast<const BlockStatement*>(stmt)->Statements);
+        break;
+    default:
+        break;
+    }
+}
+
+bool Compiler::compileStatements(const std::vector<std::unique_ptr<Statement>>& statements) {
+    for (const auto& stmt : statements) {
+        if (stmt && !Compile(stmt.get())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Leaves the value of the block's last statement on the stack, like evalBlockStatement
+bool Compiler::compileBlockValue(const BlockStatement* block) {
+    if (block && !compileStatements(block->Statements)) {
+        return false;
+    }
+
+    if (lastInstructionIs(OpCode::OpPop)) {
+        removeLastPop();
+    }
+    else {
+        emit(OpCode::OpNull);
+    }
+    return true;
+}
+
+bool Compiler::compileDeclaration(const std::string& name, const TokenType& type, const Expression* value, DeclareMode mode) {
+    if (value) {
+        if (!Compile(value)) {
+            return false;
+        }
+    }
+    else {
+        emit(OpCode::OpNull);
+        mode = DeclareMode::Unchecked;
+    }
+
+    emitDeclare(resolveForDeclare(name), type, mode);
+    return true;
+}
+
+bool Compiler::compileFunctionLiteral(const FunctionLiteral* fn) {
+    std::string name = fn->CallName ? fn->CallName->TokenLiteral() : "";
+
+    // Declared before the body is compiled so later statements and the body itself can see it
+    Symbol symbol = resolveForDeclare(name);
+
+    enterScope();
+    symbolTable->DefineFunctionName(name);
+
+    for (const auto& param : fn->Parameters) {
+        if (param && param->Name) {
+            symbolTable->Define(std::string(param->Name->Value));
+        }
+    }
+    if (fn->Body) {
+        declareStatements(fn->Body->Statements);
+    }
+
+    if (fn->Body && !compileStatements(fn->Body->Statements)) {
+        return false;
+    }
+
+    if (lastInstructionIs(OpCode::OpPop)) {
+        replaceLastPopWithReturn();
+    }
+    if (!lastInstructionIs(OpCode::OpReturnValue)) {
+        emit(OpCode::OpReturn);
+    }
+
+    std::vector<Symbol> freeSymbols = symbolTable->FreeSymbols;
+    int numLocals = symbolTable->NumLocals;
+    int maxStack = scopes.back().MaxDepth;
+    std::vector<std::string> localNames = symbolTable->LocalNames;
+    Instructions instructions = leaveScope();
+
+    auto compiledFn = MakeRef<CompiledFunction>(name, std::move(instructions), numLocals, static_cast<int>(fn->Parameters.size()));
+    compiledFn->LocalNames = std::move(localNames);
+    compiledFn->MaxStack = maxStack;
+    for (const auto& free : freeSymbols) {
+        switch (free.Scope) {
+        case SymbolScope::LOCAL:
+            compiledFn->Captures.push_back({ Capture::Kind::Local, free.Index, free.Name });
+            break;
+        case SymbolScope::FREE:
+            compiledFn->Captures.push_back({ Capture::Kind::Free, free.Index, free.Name });
+            break;
+        default:
+            compiledFn->Captures.push_back({ Capture::Kind::CurrentClosure, 0, free.Name });
+            break;
+        }
+    }
+
+    emit(OpCode::OpClosure, { static_cast<uint32_t>(addConstant(compiledFn)) });
+
+    // The literal registers itself under its name and evaluates to the function
+    emitDeclare(symbol, FUNCTION, DeclareMode::Unchecked);
+    loadSymbol(symbol);
+    return true;
+}
+
+bool Compiler::compileCallExpression(const CallExpression* call) {
+    auto callee = call->Function ? call->Function->As<Identifier>() : nullptr;
+    if (callee && callee->Value == "SCAN" && !symbolTable->Resolve(std::string(callee->Value))) {
+        return compileScan(call);
+    }
+
+    if (!Compile(call->Function.get())) {
+        return false;
+    }
+    for (const auto& arg : call->Arguments) {
+        if (!Compile(arg.get())) {
+            return false;
+        }
+    }
+
+    emit(OpCode::OpCall, { static_cast<uint32_t>(call->Arguments.size()) });
+    return true;
+}
+
+// SCAN writes into its arguments, so they are bound to variables here instead of
+// being looked up by object at runtime
+bool Compiler::compileScan(const CallExpression* call) {
+    // Arguments are evaluated first, as for any call, so unknown names fail before any input is read
+    for (const auto& arg : call->Arguments) {
+        if (!Compile(arg.get())) {
+            return false;
+        }
+        emit(OpCode::OpPop);
+    }
+
+    for (const auto& arg : call->Arguments) {
+        auto ident = arg ? arg->As<Identifier>() : nullptr;
+        if (!ident) {
+            emitRaise("Unsupported type for SCAN: ");
+            break;
+        }
+
+        Symbol symbol = resolveForDeclare(std::string(ident->Value));
+        switch (symbol.Scope) {
+        case SymbolScope::GLOBAL:
+            emit(OpCode::OpScanGlobal, { static_cast<uint32_t>(symbol.Index) });
+            break;
+        case SymbolScope::LOCAL:
+            emit(OpCode::OpScanLocal, { static_cast<uint32_t>(symbol.Index) });
+            break;
+        case SymbolScope::FREE:
+            emit(OpCode::OpScanFree, { static_cast<uint32_t>(symbol.Index) });
+            break;
+        case SymbolScope::FUNCTION:
+            emitRaise("Unsupported type for SCAN: FUNCTION");
+            break;
+        }
+    }
+
+    // Return 1 for success code
+    emit(OpCode::OpConstant, { static_cast<uint32_t>(addConstant(Value::Integer(1))) });
+    return true;
+}
+
+bool Compiler::compileAssignExpression(const AssignExpression* assign) {
+    if (assign->names.empty()) {
+        emitRaise("Error: Assignment without a variable name.");
+        return true;
+    }
+
+    if (!Compile(assign->value.get())) {
+        return false;
+    }
+
+    // Right to left, the value stays on the stack as the result of the expression
+    for (auto it = assign->names.rbegin(); it != assign->names.rend(); ++it) {
+        std::string identifier = (*it)->TokenLiteral();
+
+        auto symbol = symbolTable->Resolve(identifier);
+        if (!symbol) {
+            if (CurrentRuntime().Builtins.count(identifier) != 0) {
+                emitRaise("Error: Unknown Identifier: '" + identifier + "'");
+                continue;
+            }
+            symbol = defineGlobal(identifier);
+        }
+
+        switch (symbol->Scope) {
+        case SymbolScope::GLOBAL:
+            emit(OpCode::OpAssignGlobal, { static_cast<uint32_t>(symbol->Index) });
+            break;
+        case SymbolScope::LOCAL:
+            emit(OpCode::OpAssignLocal, { static_cast<uint32_t>(symbol->Index) });
+            break;
+        case SymbolScope::FREE:
+            emit(OpCode::OpAssignFree, { static_cast<uint32_t>(symbol->Index) });
+            break;
+        case SymbolScope::FUNCTION:
+            emitRaise("Error: Unknown Identifier: '" + identifier + "'");
+            break;
+        }
+    }
+    return true;
+}
+
+// Names that are neither declared so far nor builtins are taken to be globals
+// declared later on; reading them before that is a runtime error
+void Compiler::compileIdentifier(const std::string& name) {
+    auto symbol = symbolTable->Resolve(name);
+    if (symbol) {
+        loadSymbol(*symbol);
+        return;
+    }
+
+    const BuiltinTable& builtins = CurrentRuntime().Builtins;
+    auto it = builtins.find(name);
+    if (it != builtins.end()) {
+        emit(OpCode::OpConstant, { static_cast<uint32_t>(addConstant(it->second)) });
+        return;
+    }
+
+    loadSymbol(defineGlobal(name));
+}
+
+Symbol Compiler::defineGlobal(const std::string& name) {
+    SymbolTable* global = symbolTable.get();
+    while (global->Outer) {
+        global = global->Outer.get();
+    }
+    return global->Define(name);
+}
+
+// Declarations update the closest visible variable and only define a new one
+// when there is none, the same rule Environment::Set follows
+Symbol Compiler::resolveForDeclare(const std::string& name) {
+    auto symbol = symbolTable->Resolve(name);
+    if (symbol && symbol->Scope != SymbolScope::FUNCTION) {
+        return *symbol;
+    }
+    return symbolTable->Define(name);
+}
+
+SymbolTable* Compiler::frameTable() const {
+    SymbolTable* frame = symbolTable.get();
+    while (frame->IsBlock && frame->Outer) {
+        frame = frame->Outer.get();
+    }
+    return frame;
+}
+
+void Compiler::loadSymbol(const Symbol& symbol) {
+    switch (symbol.Scope) {
+    case SymbolScope::GLOBAL:
+        emit(OpCode::OpGetGlobal, { static_cast<uint32_t>(symbol.Index) });
+        break;
+    case SymbolScope::LOCAL:
+        emit(OpCode::OpGetLocal, { static_cast<uint32_t>(symbol.Index) });
+        break;
+    case SymbolScope::FREE:
+        emit(OpCode::OpGetFree, { static_cast<uint32_t>(symbol.Index) });
+        break;
+    case SymbolScope::FUNCTION:
+        emit(OpCode::OpCurrentClosure);
+        break;
+    }
+}
+
+void Compiler::emitDeclare(const Symbol& symbol, const TokenType& type, DeclareMode mode) {
+    uint32_t typeIndex = DeclaredTypeIndex(type);
+    uint32_t modeValue = static_cast<uint32_t>(mode);
+
+    switch (symbol.Scope) {
+    case SymbolScope::GLOBAL:
+        emit(OpCode::OpDeclareGlobal, { static_cast<uint32_t>(symbol.Index), typeIndex, modeValue });
+        break;
+    case SymbolScope::LOCAL:
+        emit(OpCode::OpDeclareLocal, { static_cast<uint32_t>(symbol.Index), typeIndex, modeValue });
+        break;
+    case SymbolScope::FREE:
+        emit(OpCode::OpDeclareFree, { static_cast<uint32_t>(symbol.Index), typeIndex, modeValue });
+        break;
+    case SymbolScope::FUNCTION:
+        emit(OpCode::OpPop);
+        break;
+    }
+}
+
+void Compiler::emitRaise(const std::string& message) {
+    emit(OpCode::OpRaise, { static_cast<uint32_t>(addConstant(MakeRef<ErrorObject>(message))) });
+}
+
+size_t Compiler::addConstant(Value obj) {
+    constants.push_back(std::move(obj));
+    return constants.size() - 1;
+}
+
+// How many operands an instruction leaves on the stack less how many it takes
+static int stackEffect(OpCode op, std::initializer_list<uint32_t> operands) {
+    switch (op) {
+    case OpCode::OpConstant:
+    case OpCode::OpTrue:
+    case OpCode::OpFalse:
+    case OpCode::OpNull:
+    case OpCode::OpGetGlobal:
+    case OpCode::OpGetLocal:
+    case OpCode::OpGetFree:
+    case OpCode::OpCurrentClosure:
+    case OpCode::OpClosure:
+        return 1;
+    case OpCode::OpPop:
+    case OpCode::OpAdd:
+    case OpCode::OpSub:
+    case OpCode::OpMul:
+    case OpCode::OpDiv:
+    case OpCode::OpConcat:
+    case OpCode::OpEqual:
+    case OpCode::OpNotEqual:
+    case OpCode::OpLessThan:
+    case OpCode::OpGreaterThan:
+    case OpCode::OpJumpNotTruthy:
+    case OpCode::OpDeclareGlobal:
+    case OpCode::OpDeclareLocal:
+    case OpCode::OpDeclareFree:
+    case OpCode::OpReturnValue:
+        return -1;
+    case OpCode::OpCall:
+        // The callee and its arguments make way for the result
+        return -static_cast<int>(*operands.begin());
+    default:
+        return 0;
+    }
+}
+
+// Make cuts operands down to their width, so ones that don't fit are compile errors
+void Compiler::checkOperands(OpCode op, std::initializer_list<uint32_t> operands) {
+    const Definition& def = Lookup(op);
+
+    size_t i = 0;
+    for (uint32_t operand : operands) {
+        int width = def.OperandWidths[i++];
+        if (width < 4 && operand >> (8 * width) != 0) {
+            errors.push_back("Error: " + def.Name + " operand " + std::to_string(operand) +
+                " exceeds the limit of " + std::to_string((1u << (8 * width)) - 1) + " (too many variables or arguments)");
+        }
+    }
+}
+
+size_t Compiler::emit(OpCode op, std::initializer_list<uint32_t> operands) {
+    checkOperands(op, operands);
+    Instructions ins = Make(op, operands);
+    size_t pos = addInstruction(ins);
+    setLastInstruction(op, pos);
+    trackStack(stackEffect(op, operands));
+    return pos;
+}
+
+size_t Compiler::addInstruction(const Instructions& ins) {
+    Instructions& current = currentInstructions();
+    size_t posNewInstruction = current.size();
+    current.insert(current.end(), ins.begin(), ins.end());
+    return posNewInstruction;
+}
+
+void Compiler::trackStack(int effect) {
+    CompilationScope& scope = scopes.back();
+    scope.Depth += effect;
+    scope.MaxDepth = std::max(scope.MaxDepth, scope.Depth);
+}
+
+void Compiler::setLastInstruction(OpCode op, size_t pos) {
+    CompilationScope& scope = scopes.back();
+    scope.PreviousInstruction = scope.LastInstruction;
+    scope.LastInstruction = { op, pos };
+}
+
+bool Compiler::lastInstructionIs(OpCode op) const {
+    const CompilationScope& scope = scopes.back();
+    if (scope.Instructions_.empty()) {
+        return false;
+    }
+    return scope.LastInstruction.Opcode == op && scope.LastInstruction.Position + Make(op).size() == scope.Instructions_.size();
+}
+
+void Compiler::removeLastPop() {
+    CompilationScope& scope = scopes.back();
+    scope.Instructions_.resize(scope.LastInstruction.Position);
+    scope.LastInstruction = scope.PreviousInstruction;
+    trackStack(1); // The value it took stays
+}
+
+void Compiler::replaceLastPopWithReturn() {
+    CompilationScope& scope = scopes.back();
+    scope.Instructions_[scope.LastInstruction.Position] = static_cast<uint8_t>(OpCode::OpReturnValue);
+    scope.LastInstruction.Opcode = OpCode::OpReturnValue;
+}
+
+void Compiler::changeOperand(size_t opPos, std::initializer_list<uint32_t> operands) {
+    Instructions& current = currentInstructions();
+    OpCode op = static_cast<OpCode>(current[opPos]);
+    checkOperands(op, operands);
+    Instructions newInstruction = Make(op, operands);
+    std::copy(newInstruction.begin(), newInstruction.end(), current.begin() + opPos);
+}
+
+Instructions& Compiler::currentInstructions() {
+    return scopes.back().Instructions_;
+}
+
+void Compiler::enterScope() {
+    scopes.push_back(CompilationScope{});
+    symbolTable = std::make_shared<SymbolTable>(symbolTable, false);
+}
+
+Instructions Compiler::leaveScope() {
+    Instructions instructions = std::move(scopes.back().Instructions_);
+    scopes.pop_back();
+    symbolTable = symbolTable->Outer;
+    return instructions;
+}
+
+// Returns the first frame slot the block will hand out
+int Compiler::enterBlock() {
+    symbolTable = std::make_shared<SymbolTable>(symbolTable, true);
+    return frameTable()->NumLocals;
+}
+
+// Patches the loop's OpClearLocals with the slots its body ended up declaring
+void Compiler::leaveBlock(size_t clearPos, int firstLocal) {
+    SymbolTable* frame = frameTable();
+    changeOperand(clearPos, { static_cast<uint32_t>(firstLocal), static_cast<uint32_t>(frame->NumLocals - firstLocal) });
+
+    symbolTable = symbolTable->Outer;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "AST.h"
+#include "Object.h"
+#include "Code.h"
+#include "SymbolTable.h"
+
+struct Bytecode {
+    Instructions Instructions_;
+    std::vector<Value> Constants;
+    int NumGlobals = 0;
+    int NumLocals = 0; // Locals of the top level frame (WHILE bodies at the top level)
+    std::vector<std::string> GlobalNames;
+    std::vector<std::string> LocalNames;
+    std::vector<size_t> StatementStarts; // Offsets of the top level statements, used to recover from errors
+    int MaxStack = 0; // Of the top level code, see CompiledFunction::MaxStack
+};
+
+// Compiles a Program into bytecode for the VM. Mirrors the structure of Eval:
+// one case per AST node.
+class Compiler {
+public:
+    Compiler();
+
+    bool Compile(const Node* node);
+    Bytecode GetBytecode() const;
+
+    std::vector<std::string> Errors() const;
+
+private:
+    struct EmittedInstruction {
+        OpCode Opcode = OpCode::OpNull;
+        size_t Position = 0;
+    };
+
+    struct CompilationScope {
+        Instructions Instructions_;
+        EmittedInstruction LastInstruction;
+        EmittedInstruction PreviousInstruction;
+        std::vector<size_t> LoopStarts; // Enclosing WHILE loops of this function
+        int Depth = 0;    // Operands on the stack after the last instruction
+        int MaxDepth = 0; // Deepest Depth got, the function's MaxStack
+    };
+
+    std::vector<Value> constants;
+    std::shared_ptr<SymbolTable> symbolTable;
+    std::vector<CompilationScope> scopes;
+    std::vector<size_t> statementStarts;
+    std::vector<std::string> errors;
+
+    void declareStatements(const std::vector<std::unique_ptr<Statement>>& statements);
+    void declareStatement(const Statement* stmt);
+    bool compileStatements(const std::vector<std::unique_ptr<Statement>>& statements);
+    bool compileBlockValue(const BlockStatement* block);
+    bool compileDeclaration(const std::string& name, const TokenType& type, const Expression* value, DeclareMode mode);
+    bool compileFunctionLiteral(const FunctionLiteral* fn);
+    bool compileCallExpression(const CallExpression* call);
+    bool compileScan(const CallExpression* call);
+    bool compileAssignExpression(const AssignExpression* assign);
+
+    size_t addConstant(Value obj);
+    void checkOperands(OpCode op, std::initializer_list<uint32_t> operands);
+    size_t emit(OpCode op, std::initializer_list<uint32_t> operands = {});
+    size_t addInstruction(const Instructions& ins);
+    void setLastInstruction(OpCode op, size_t pos);
+    void trackStack(int effect);
+    bool lastInstructionIs(OpCode op) const;
+    void removeLastPop();
+    void replaceLastPopWithReturn();
+    void changeOperand(size_t opPos, std::initializer_list<uint32_t> operands);
+    Instructions& currentInstructions();
+
+    void enterScope();
+    Instructions leaveScope();
+    int enterBlock();
+    void leaveBlock(size_t clearPos, int firstLocal);
+    SymbolTable* frameTable() const;
+
+    void compileIdentifier(const std::string& name);
+    Symbol defineGlobal(const std::string& name);
+    Symbol resolveForDeclare(const std::string& name);
+    void loadSymbol(const Symbol& symbol);
+    void emitDeclare(const Symbol& symbol, const TokenType& type, DeclareMode mode);
+    void emitRaise(const std::string& message);
+};
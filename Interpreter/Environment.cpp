@@ -1,69 +1,120 @@
 #include "Environment.h"
 
-std::shared_ptr<Object> Environment::GetObject(const std::string& name) const {
-    auto iter = store.find(name);
-    if (iter != store.end()) {
-        return std::get<2>(iter->second); // Return the Object part of the tuple
-    }
-    else if (outer != nullptr) {
-        return outer->GetObject(name);
+#include <algorithm>
+
+Function::Function(const Token& returnType, std::unique_ptr<Expression> callName, std::vector<std::unique_ptr<TypedDeclStatement>> params, std::unique_ptr<BlockStatement> body, Ref<Environment> env)
+    : Object(TypeTag, true), ReturnType(returnType), CallName(std::move(callName)), Parameters(std::move(params)), Body(std::move(body)), Env(std::move(env)) {}
+
+Function::~Function() = default;
+
+void Function::Trace(GcVisitor& visitor) const {
+    visitor.Visit(Env.get());
+}
+
+void Function::ClearRefs() {
+    Env.reset();
+}
+
+void Environment::Trace(GcVisitor& visitor) const {
+    for (const auto& binding : slots) {
+        if (binding.Value.IsObject()) {
+            visitor.Visit(binding.Value.AsObject().get());
+        }
     }
-    return nullptr;
+    visitor.Visit(outer.get());
 }
 
-Token Environment::GetType(const std::string& name) const {
-    auto iter = store.find(name);
-    if (iter != store.end()) {
-        return std::get<0>(iter->second);
+void Environment::ClearRefs() {
+    slots.clear();
+    outer.reset();
+}
+
+Environment* Environment::frameAt(int depth) {
+    Environment* env = this;
+    while (depth-- > 0) {
+        env = env->outer.get();
     }
-    else if (outer != nullptr) {
-        return outer->GetType(name);
+    return env;
+}
+
+const Environment* Environment::frameAt(int depth) const {
+    const Environment* env = this;
+    while (depth-- > 0) {
+        env = env->outer.get();
     }
-    // Return a default Token if not found
-    return { "","" };
+    return env;
 }
 
-bool Environment::Exists(const std::string& name) const {
-    if (store.find(name) != store.end()) {
-        return true;
+Environment* Environment::global() {
+    Environment* env = this;
+    while (env->outer != nullptr) {
+        env = env->outer.get();
     }
-    else if (outer) {
-        return outer->Exists(name);
+    return env;
+}
+
+const Environment* Environment::global() const {
+    const Environment* env = this;
+    while (env->outer != nullptr) {
+        env = env->outer.get();
     }
-    return false;
+    return env;
+}
 
+void Environment::Clear() {
+    std::fill(slots.begin(), slots.end(), Binding{});
 }
 
-//void Environment::Set(const std::string& name, Token type, std::shared_ptr<Object> val) {
-//    store[name] = std::make_tuple(type, name, val);
-//    reverseStore[val] = name;
-//}
+const Value& Environment::GetValue(int depth, int slot) const {
+    return frameAt(depth)->slots[slot].Value;
+}
 
-void Environment::Set(const std::string& name, Token type, std::shared_ptr<Object> val) {
-    if (Exists(name)) {
-        // If the variable exists anywhere in the chain, find the closest definition and update it.
-        Environment* env = this;
-        while (env->outer != nullptr && !env->store.count(name)) {
-            env = env->outer.get();
-        }
-        env->store[name] = std::make_tuple(type, name, val);  
-    }
-    else {
-        // If it does not exist, define it in the current environment
-        store[name] = std::make_tuple(type, name, val);
-    }
-    reverseStore[val] = name;  // Update reverse lookup in the current environment (in case we need it)
+TokenType Environment::GetType(int depth, int slot) const {
+    return frameAt(depth)->slots[slot].Type;
+}
+
+void Environment::Set(int depth, int slot, TokenType type, Value val) {
+    frameAt(depth)->slots[slot] = Binding{ type, std::move(val) };
+}
+
+int Environment::FindGlobal(const std::string& name) const {
+    const Environment* env = global();
+    auto iter = env->globalSlots.find(name);
+    return iter != env->globalSlots.end() ? iter->second : -1;
 }
 
+int Environment::DefineGlobal(const std::string& name) {
+    Environment* env = global();
+    auto [iter, inserted] = env->globalSlots.try_emplace(name, static_cast<int>(env->slots.size()));
+    if (inserted) {
+        env->slots.emplace_back();
+    }
+    return iter->second;
+}
 
-std::string Environment::GetNameByObject(const std::shared_ptr<Object>& obj) const {
-    auto it = reverseStore.find(obj);
-    if (it != reverseStore.end()) {
-        return it->second;
+Value Environment::GetValue(const std::string& name) const {
+    int slot = FindGlobal(name);
+    if (slot < 0) {
+        return nullptr;
     }
-    else if (outer != nullptr) {
-        return outer->GetNameByObject(obj);
+    return global()->slots[slot].Value;
+}
+
+TokenType Environment::GetType(const std::string& name) const {
+    int slot = FindGlobal(name);
+    if (slot < 0) {
+        // Return NONE if not found
+        return NONE;
     }
-    return ""; 
+    return global()->slots[slot].Type;
 }
 
+bool Environment::Exists(const std::string& name) const {
+    return GetType(name) != NONE;
+}
+
+void Environment::Set(const std::string& name, TokenType type, Value val) {
+    Environment* env = global();
+    int slot = DefineGlobal(name);
+    env->slots[slot] = Binding{ type, std::move(val) };
+}
@@ -3,22 +3,51 @@
 #include "Object.h"
 #include <string>
 #include <unordered_map>
+#include <vector>
 #include <memory>
 
-class Environment {
+// One frame of variables: the program's globals, a function call, or one
+// iteration of a WHILE body. The Resolver lays out every frame ahead of time,
+// so variables are read and written by (depth, slot) and never hashed.
+//
+// The global frame also keeps a name -> slot table. The Resolver extends it as
+// it meets new declarations, which lets a REPL session add globals line by line,
+// and the name based accessors below only ever look there.
+class Environment : public Collectable {
 private:
-    using StoreValue = std::tuple<Token, std::string, std::shared_ptr<Object>>;
-    std::unordered_map<std::string, StoreValue> store;
-    std::unordered_map<std::shared_ptr<Object>, std::string> reverseStore;
-    std::shared_ptr<Environment> outer;
+    std::vector<Binding> slots;
+    std::unordered_map<std::string, int> globalSlots;
+    Ref<Environment> outer;
+
+    Environment* frameAt(int depth);
+    const Environment* frameAt(int depth) const;
+    Environment* global();
+    const Environment* global() const;
 
 public:
-    Environment() : outer(nullptr) {}
-    explicit Environment(std::shared_ptr<Environment> outerEnv) : outer(std::move(outerEnv)) {}
+    Environment() : Collectable(true), outer(nullptr) {}
+    Environment(Ref<Environment> outerEnv, int numSlots)
+        : Collectable(true), slots(numSlots), outer(std::move(outerEnv)) {}
+
+    // Its slots may hold the FUNCTIONs that close over it
+    void Trace(GcVisitor& visitor) const override;
+    void ClearRefs() override;
+
+    // Empties every slot, so a WHILE frame can serve the next iteration
+    void Clear();
+
+    // Resolved access
+    const Value& GetValue(int depth, int slot) const;
+    TokenType GetType(int depth, int slot) const;
+    void Set(int depth, int slot, TokenType type, Value val);
+
+    // Global name table
+    int FindGlobal(const std::string& name) const;   // -1 if never declared
+    int DefineGlobal(const std::string& name);       // Existing slot or a new one
 
-    std::shared_ptr<Object> GetObject(const std::string& name) const;
-    Token GetType(const std::string& name) const;
+    // Name based access to globals, for names the Resolver left unresolved
+    Value GetValue(const std::string& name) const;
+    TokenType GetType(const std::string& name) const;
     bool Exists(const std::string& name) const;
-    void Set(const std::string& name, Token type, std::shared_ptr<Object> val);
-    std::string GetNameByObject(const std::shared_ptr<Object>& obj) const;
+    void Set(const std::string& name, TokenType type, Value val);
 };
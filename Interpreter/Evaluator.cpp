@@ -1,121 +1,70 @@
 #include "Evaluator.h"
 
-int evaluatorCurrentLine = 0;
-static size_t evaluatorCommentIndex;
-
-static void incrementEvaluatorLine() {
-    evaluatorCurrentLine++;
-    // Continue to skip comment lines without modifying the vector
-    while (evaluatorCommentIndex < Lexer::commentLinePositions.size() &&
-        evaluatorCurrentLine == Lexer::commentLinePositions[evaluatorCommentIndex]) {
-        evaluatorCurrentLine++;
-        evaluatorCommentIndex++;  // Move to the next comment line index
-    }
-}
-
-std::unordered_map<std::string, std::shared_ptr<Builtin>> builtins = {
-    {"LEN", std::make_shared<Builtin>(
-        [](const std::vector<std::shared_ptr<Object>>& args, std::shared_ptr<Environment> env) -> std::shared_ptr<Object> {
-            if (args.size() != 1) {
-                return std::make_shared<ErrorObject>("wrong number of arguments. got=" + std::to_string(args.size()) + ", want=1");
-            }
+#include <cctype>
+#include <charconv>
+
+BuiltinTable MakeBuiltins() {
+    return {
+        {"LEN", MakeRef<Builtin>(
+            [](const std::vector<Value>& args, Environment* env) -> Value {
+                if (args.size() != 1) {
+                    return MakeRef<ErrorObject>("wrong number of arguments. got=" + std::to_string(args.size()) + ", want=1");
+                }
 
-            if (auto str = std::dynamic_pointer_cast<String>(args[0])) {
-                return std::make_shared<IntegerObject>(static_cast<int64_t>(str->Value.length()));
-            } else {
-                return std::make_shared<ErrorObject>("argument to `LEN` not supported, got " + args[0]->Type());
-            }
-        }
-    )},
-    {"DISPLAY", std::make_shared<Builtin>(
-        [](const std::vector<std::shared_ptr<Object>>& args, std::shared_ptr<Environment> env) -> std::shared_ptr<Object> {
-            if (args.size() != 1) {
-                return std::make_shared<ErrorObject>("wrong number of arguments. got=" + std::to_string(args.size()) + ", want=1");
-            }
-            // Return 1 for success code
-            if (auto str = std::dynamic_pointer_cast<String>(args[0])) {
-                std::cout << str->Value << std::endl;
-                return std::make_shared<IntegerObject>(1);  
-                //return str;
-            }
-            if (auto num = std::dynamic_pointer_cast<IntegerObject>(args[0])) {
-                std::cout << num->Value << std::endl;
-                return std::make_shared<IntegerObject>(1);
-                //return num;
-            }
-            if (auto bl = std::dynamic_pointer_cast<BooleanObject>(args[0])) {
-                std::string display = bl->Value ? "TRUE" : "FALSE";
-                std::cout << display << std::endl;
-                return std::make_shared<IntegerObject>(1);
-                //return num;
-            }
-            if (auto c = std::dynamic_pointer_cast<Char>(args[0])) {
-                std::cout << c->Value << std::endl;
-                return std::make_shared<IntegerObject>(1);
-                //return num;
-            }
-            if (auto f = std::dynamic_pointer_cast<FloatObject>(args[0])) {
-                std::cout << f->Value << std::endl;
-                return std::make_shared<IntegerObject>(1);
-            }
-            else {
-              return std::make_shared<ErrorObject>("argument to `DISPLAY` not supported, got " + args[0]->Type());
+                if (auto str = args[0].As<String>()) {
+                    return Value::Integer(static_cast<int>(str->Value.length()));
+                } else {
+                    return MakeRef<ErrorObject>("argument to `LEN` not supported, got " + args[0].Type());
+                }
             }
-        }
-    )},
-    {"SCAN", std::make_shared<Builtin>(
-        [](const std::vector<std::shared_ptr<Object>>& args, std::shared_ptr<Environment> env) -> std::shared_ptr<Object> {
-            
-            for (const auto& arg : args) {
-                //std::cout << "SCAN INSPECT: " << arg->Inspect() << std::endl;
-                std::string varName = env->GetNameByObject(arg);
-                //std::cout << "SCAN INSPECT: " << varName << std::endl;
-                //std::cout << "SCAN INSPECT: " << env->GetType(varName).Type << std::endl;
-
-                auto varType = env->GetType(varName);
-                //std::cout << "Got " << varType.Type << " type." << std::endl;
-
-                if (varType.Type != INT && varType.Type != BOOL && varType.Type != STRING && varType.Type != CHAR) {
-                    return std::make_shared<ErrorObject>("Unsupported type for SCAN: " + varType.Literal);
+        )},
+        {"DISPLAY", MakeRef<Builtin>(
+            [](const std::vector<Value>& args, Environment* env) -> Value {
+                if (args.size() != 1) {
+                    return MakeRef<ErrorObject>("wrong number of arguments. got=" + std::to_string(args.size()) + ", want=1");
                 }
-
-                std::string input;
-                //std::cout << "Enter input for " << varName << ": ";
-                std::getline(std::cin, input);
-
-                
-                if (varType.Type == INT) {
-                    try {
-                        int value = std::stoi(input);
-                        env->Set(varName, varType, std::make_shared<IntegerObject>(value));
-                    }
-                    catch (const std::invalid_argument& e) {
-                        return std::make_shared<ErrorObject>("Invalid input for type " + varType.Literal);
-                    }
-                    catch (const std::out_of_range& e) {
-                        return std::make_shared<ErrorObject>("Input out of range for type " + varType.Literal);
-                    }
+                // Return 1 for success code
+                Output& out = StandardOutput();
+                if (auto str = args[0].As<String>()) {
+                    out.Write(str->Value).EndLine();
+                    return Value::Integer(1);  
+                    //return str;
+                }
+                if (args[0].IsInteger()) {
+                    out.Write(args[0].AsInteger()).EndLine();
+                    return Value::Integer(1);
+                    //return num;
                 }
-                else if (varType.Type == STRING) {
-                    env->Set(varName, varType, std::make_shared<String>(input));
+                if (args[0].IsBoolean()) {
+                    out.Write(args[0].AsBoolean() ? "TRUE" : "FALSE").EndLine();
+                    return Value::Integer(1);
+                    //return num;
                 }
-                else if (varType.Type == BOOL) {
-                    bool value = (input == "TRUE" || input == "1");
-                    env->Set(varName, varType, std::make_shared<BooleanObject>(value));
+                if (args[0].IsChar()) {
+                    out.Write(args[0].AsChar()).EndLine();
+                    return Value::Integer(1);
+                    //return num;
                 }
-                else if (varType.Type == CHAR) {
-                    if (input.length() != 1) {
-                        return std::make_shared<ErrorObject>("Invalid input size for CHAR type. Expected a single character.");
-                    }
-                    char value = input.front();
-                    env->Set(varName, varType, std::make_shared<Char>(value));
+                if (args[0].IsFloat()) {
+                    out.Write(args[0].AsFloat()).EndLine();
+                    return Value::Integer(1);
+                }
+                else {
+                  return MakeRef<ErrorObject>("argument to `DISPLAY` not supported, got " + args[0].Type());
                 }
             }
-            // Return 1 for success code
-            return std::make_shared<IntegerObject>(1);
-        }
-    )},
-};
+        )},
+        {"SCAN", MakeRef<Builtin>(
+            // SCAN writes into the variables named by its arguments. Values don't
+            // know which variable they came from, so a call of SCAN is handled
+            // where the argument expressions are still available (evalScan and
+            // Compiler::compileScan). Reaching this means SCAN was called indirectly.
+            [](const std::vector<Value>&, Environment*) -> Value {
+                return MakeRef<ErrorObject>("SCAN can only be called directly with variable arguments");
+            }
+        )},
+    };
+}
 
 
 template<typename T>
@@ -138,175 +87,176 @@ static void handleArgs(std::ostringstream& os, T&& firstArg, Args&&... args) {
 }
 
 template<typename... Args>
-static void formatMessage(std::ostringstream& message, int line, const std::string& format, Args... args) {
-    //message << "Error on line " << line << ": " << format;
+static void formatMessage(std::ostringstream& message, const std::string& format, Args... args) {
     message << "Error: " << format;
     handleArgs(message, std::forward<Args>(args)...);
 }
 
 template<typename... Args>
-static std::shared_ptr<ErrorObject> newError(const std::string& format, Args... args) {
+static Ref<ErrorObject> newError(const std::string& format, Args... args) {
     std::ostringstream message;
-    formatMessage(message, evaluatorCurrentLine, format, std::forward<Args>(args)...);
-    return std::make_unique<ErrorObject>(message.str());
+    formatMessage(message, format, std::forward<Args>(args)...);
+    return MakeRef<ErrorObject>(message.str());
 }
 
-static bool isError(const std::shared_ptr<Object>& obj) {
-    if (obj) {
-        return obj->Type() == ObjectTypeToString(ObjectType_::ERROR_OBJ);
+static bool isError(const Value& obj) {
+    return obj.Is(ObjectType_::ERROR_OBJ);
+}
+
+// Line a statement starts on, only looked at once it has failed
+static uint32_t statementLine(const Statement* statement) {
+    switch (statement->Kind) {
+    case NodeKind::ExpressionStatement: return static_cast<const ExpressionStatement*>(statement)->token.Line;
+    case NodeKind::TypedDeclStatement: return static_cast<const TypedDeclStatement*>(statement)->token.Line;
+    case NodeKind::MultiTypedDeclStatement: return static_cast<const MultiTypedDeclStatement*>(statement)->token.Line;
+    case NodeKind::ReturnStatement: return static_cast<const ReturnStatement*>(statement)->token.Line;
+    case NodeKind::MarkerStatement: return static_cast<const MarkerStatement*>(statement)->token.Line;
+    default: return 0;
     }
-    return false;
+}
 
+// An error takes the line of the innermost statement it leaves, which is
+// right inside loops and calls however often they ran
+static void setErrorLine(const Value& result, const Statement* statement) {
+    if (auto error = result.As<ErrorObject>(); error && error->Line == 0) {
+        error->Line = statementLine(statement);
+    }
 }
 
 static void logError(const std::string& errorMessage) {
-    std::cout << "Error: " << errorMessage << std::endl;
+    StandardOutput().Write("Error: ").Write(errorMessage).EndLine();
 }
 
-static std::shared_ptr<Object> evalProgram(const std::vector<std::unique_ptr<Statement>>& stmts, const std::shared_ptr<Environment>& env) {
-    std::shared_ptr<Object> result;
+static Value evalProgram(const std::vector<std::unique_ptr<Statement>>& stmts, const Ref<Environment>& env) {
+    Runtime& runtime = CurrentRuntime();
+    Value result;
     for (const auto& statement : stmts) {
-        // Dynamic cast to Node* for Eval
-        const Node* node = dynamic_cast<const Node*>(statement.get());
-        if (node) {
-            result = Eval(node, env);
-            if (auto returnValue = dynamic_cast<ReturnValue*>(result.get())) {
-                return std::shared_ptr<Object>(returnValue->TakeValue());
-            }
-            else if (auto error = dynamic_cast<ErrorObject*>(result.get())) {
-                std::cout << error->Message << std::endl;
-                //return result;
-            }
+        runtime.Gc.MaybeCollect();
+        ++runtime.EvaluatedStatements;
+        result = Eval(statement.get(), env);
+        if (auto returnValue = result.As<ReturnValue>()) {
+            return returnValue->TakeValue();
         }
-        else {
-            throw std::runtime_error("Failed to cast Statement to Node");
+        else if (auto error = result.As<ErrorObject>()) {
+            setErrorLine(result, statement.get());
+            StandardOutput().Write(error->Message).EndLine();
+            //return result;
         }
     }
     return result; // Default return path
 }
 
-static std::shared_ptr<Object> evalBangOperatorExpression(std::shared_ptr<Object> right) {
-    if (auto booleanRight = dynamic_cast<BooleanObject*>(right.get())) {
-        return std::make_unique<BooleanObject>(!booleanRight->Value);
-    }
-    else if (dynamic_cast<NullObject*>(right.get())) {
-        // NULL is considered falsy, so negating it returns TRUE
-        return std::make_unique<BooleanObject>(true);
-    }
-    // For all other object types, consider them truthy, thus negation returns FALSE
-    else {
-        return std::make_unique<BooleanObject>(false);
-    }
+static Value evalBangOperatorExpression(const Value& right) {
+    // NULL and FALSE negate to TRUE, everything else to FALSE
+    return Value::Boolean(!right.IsTruthy());
 }
 
-static std::shared_ptr<Object> evalMinusPrefixOperatorExpression(std::shared_ptr<Object> right) {
-    IntegerObject* integerRight = dynamic_cast<IntegerObject*>(right.get());
-
-    if (!integerRight) {
-        return newError("Unknown operator: -", right->Type());
+static Value evalMinusPrefixOperatorExpression(const Value& right) {
+    if (!right.IsInteger()) {
+        return newError("Unknown operator: -", right.Type());
     }
 
-    return std::make_unique<IntegerObject>(-integerRight->Value);
+    return Value::Integer(-right.AsInteger());
 }
 
-static std::shared_ptr<Object> evalPrefixExpression(const std::string& operator_, std::shared_ptr<Object> right) {
+Value evalPrefixExpression(std::string_view operator_, const Value& right) {
     if (operator_ == "!") {
-        return evalBangOperatorExpression(std::move(right));
+        return evalBangOperatorExpression(right);
     }
     if (operator_ == "-") {
-        return evalMinusPrefixOperatorExpression(std::move(right));
+        return evalMinusPrefixOperatorExpression(right);
     }
     // Default case returns a unique pointer to a new NullObject
-    return newError("Unknown operator: ", operator_, right->Type());
+    return newError("Unknown operator: ", operator_, right.Type());
 }
 
-static std::shared_ptr<Object> evalIntegerInfixExpression(
-    const std::string& operator_,
-    std::shared_ptr<Object> left,
-    std::shared_ptr<Object> right) {
+static Value evalIntegerInfixExpression(
+    std::string_view operator_,
+    const Value& left,
+    const Value& right) {
 
-    auto leftVal = dynamic_cast<IntegerObject*>(left.get())->Value;
-    auto rightVal = dynamic_cast<IntegerObject*>(right.get())->Value;
+    auto leftVal = left.AsInteger();
+    auto rightVal = right.AsInteger();
 
     if (operator_ == "+") {
-        return std::make_unique<IntegerObject>(leftVal + rightVal);
+        return Value::Integer(leftVal + rightVal);
     }
     else if (operator_ == "-") {
-        return std::make_unique<IntegerObject>(leftVal - rightVal);
+        return Value::Integer(leftVal - rightVal);
     }
     else if (operator_ == "*") {
-        return std::make_unique<IntegerObject>(leftVal * rightVal);
+        return Value::Integer(leftVal * rightVal);
     }
     else if (operator_ == "/") {
         if (rightVal == 0) {
             // TODO: Maybe throw an error here
-            return std::make_unique<NullObject>(); 
+            return Value::Null();
         }
-        return std::make_unique<IntegerObject>(leftVal / rightVal);
+        return Value::Integer(leftVal / rightVal);
     }
     else if (operator_ == "<") {
-        return std::make_unique<BooleanObject>(leftVal < rightVal);
+        return Value::Boolean(leftVal < rightVal);
     }
     else if (operator_ == ">") {
-        return std::make_unique<BooleanObject>(leftVal > rightVal);
+        return Value::Boolean(leftVal > rightVal);
     }
     else if (operator_ == "==") {
-        return std::make_unique<BooleanObject>(leftVal == rightVal);
+        return Value::Boolean(leftVal == rightVal);
     }
     else if (operator_ == "<>") {
-        return std::make_unique<BooleanObject>(leftVal != rightVal);
+        return Value::Boolean(leftVal != rightVal);
     }
-    return newError("Unknown operator: ", left->Type(), operator_, right->Type());  
+    return newError("Unknown operator: ", left.Type(), operator_, right.Type());
 }
 
-static std::shared_ptr<Object> evalFloatInfixExpression(
-    const std::string& operator_,
-    std::shared_ptr<Object> left,
-    std::shared_ptr<Object> right) {
+static Value evalFloatInfixExpression(
+    std::string_view operator_,
+    const Value& left,
+    const Value& right) {
 
-    auto leftVal = (left->Type() == ObjectTypeToString(ObjectType_::INTEGER_OBJ)) ?
-        static_cast<float>(dynamic_cast<IntegerObject*>(left.get())->Value) :
-        dynamic_cast<FloatObject*>(left.get())->Value;
+    auto leftVal = left.IsInteger() ?
+        static_cast<float>(left.AsInteger()) :
+        left.AsFloat();
 
-    auto rightVal = (right->Type() == ObjectTypeToString(ObjectType_::INTEGER_OBJ)) ?
-        static_cast<float>(dynamic_cast<IntegerObject*>(right.get())->Value) :
-        dynamic_cast<FloatObject*>(right.get())->Value;
+    auto rightVal = right.IsInteger() ?
+        static_cast<float>(right.AsInteger()) :
+        right.AsFloat();
 
 
     if (operator_ == "+") {
-        return std::make_shared<FloatObject>(leftVal + rightVal);
+        return Value::Float(leftVal + rightVal);
     }
     else if (operator_ == "-") {
-        return std::make_shared<FloatObject>(leftVal - rightVal);
+        return Value::Float(leftVal - rightVal);
     }
     else if (operator_ == "*") {
-        return std::make_shared<FloatObject>(leftVal * rightVal);
+        return Value::Float(leftVal * rightVal);
     }
     else if (operator_ == "/") {
         if (rightVal == 0) {
-            return std::make_shared<ErrorObject>("Division by zero");
+            return MakeRef<ErrorObject>("Division by zero");
         }
-        return std::make_shared<FloatObject>(leftVal / rightVal);
+        return Value::Float(leftVal / rightVal);
     }
     else if (operator_ == "<") {
-        return std::make_shared<BooleanObject>(leftVal < rightVal);
+        return Value::Boolean(leftVal < rightVal);
     }
     else if (operator_ == ">") {
-        return std::make_shared<BooleanObject>(leftVal > rightVal);
+        return Value::Boolean(leftVal > rightVal);
     }
     else if (operator_ == "==") {
-        return std::make_shared<BooleanObject>(leftVal == rightVal);
+        return Value::Boolean(leftVal == rightVal);
     }
     else if (operator_ == "<>") {
-        return std::make_shared<BooleanObject>(leftVal != rightVal);
+        return Value::Boolean(leftVal != rightVal);
     }
-    return std::make_shared<ErrorObject>("unknown operator: " + left->Type() + " " + operator_ + " " + right->Type());
+    return MakeRef<ErrorObject>("unknown operator: " + left.Type() + " " + std::string(operator_) + " " + right.Type());
 }
 
-//static std::shared_ptr<Object> evalStringInfixExpression(
+//static Ref<Object> evalStringInfixExpression(
 //    const std::string& operator_,
-//    std::shared_ptr<Object> left,
-//    std::shared_ptr<Object> right) {
+//    Ref<Object> left,
+//    Ref<Object> right) {
 //
 //    std::string leftVal;
 //    if (left->Type() == ObjectTypeToString(ObjectType_::STRING_OBJ)) {
@@ -316,7 +266,7 @@ static std::shared_ptr<Object> evalFloatInfixExpression(
 //        leftVal = std::string(1, dynamic_cast<Char*>(left.get())->Value);
 //    }
 //    else {
-//        return std::make_shared<ErrorObject>("left-hand operand of & must be a string or char, got " + left->Type());
+//        return MakeRef<ErrorObject>("left-hand operand of & must be a string or char, got " + left->Type());
 //    }
 //
 //    std::string rightVal;
@@ -327,35 +277,35 @@ static std::shared_ptr<Object> evalFloatInfixExpression(
 //        rightVal = std::string(1, dynamic_cast<Char*>(right.get())->Value);
 //    }
 //    else {
-//        return std::make_shared<ErrorObject>("right-hand operand of & must be a string or char, got " + right->Type());
+//        return MakeRef<ErrorObject>("right-hand operand of & must be a string or char, got " + right->Type());
 //    }
 //
 //    if (operator_ == "&") {
-//        return std::make_shared<String>(leftVal + rightVal);
+//        return MakeRef<String>(leftVal + rightVal);
 //    }
-//    return std::make_shared<ErrorObject>("unknown operator: " + operator_ + " for types " + left->Type() + " and " + right->Type());
+//    return MakeRef<ErrorObject>("unknown operator: " + operator_ + " for types " + left->Type() + " and " + right->Type());
 //}
 
-static std::shared_ptr<Object> evalStringInfixExpression(
-    const std::string& operator_,
-    std::shared_ptr<Object> left,
-    std::shared_ptr<Object> right) {
+static Value evalStringInfixExpression(
+    std::string_view operator_,
+    const Value& left,
+    const Value& right) {
 
-    auto objectToString = [](const std::shared_ptr<Object>& obj) -> std::string {
-        if (auto str = dynamic_cast<String*>(obj.get())) {
+    auto objectToString = [](const Value& obj) -> std::string {
+        if (auto str = obj.As<String>()) {
             return str->Value;
         }
-        else if (auto ch = dynamic_cast<Char*>(obj.get())) {
-            return std::string(1, ch->Value);
+        else if (obj.IsChar()) {
+            return std::string(1, obj.AsChar());
         }
-        else if (auto num = dynamic_cast<IntegerObject*>(obj.get())) {
-            return std::to_string(num->Value);
+        else if (obj.IsInteger()) {
+            return std::to_string(obj.AsInteger());
         }
-        else if (auto flt = dynamic_cast<FloatObject*>(obj.get())) {
-            return std::to_string(flt->Value);
+        else if (obj.IsFloat()) {
+            return std::to_string(obj.AsFloat());
         }
-        else if (auto bol = dynamic_cast<BooleanObject*>(obj.get())) {
-            return bol->Value ? "TRUE" : "FALSE";
+        else if (obj.IsBoolean()) {
+            return obj.AsBoolean() ? "TRUE" : "FALSE";
         }
         else {
             throw std::runtime_error("Unsupported type for string concatenation.");
@@ -367,164 +317,127 @@ static std::shared_ptr<Object> evalStringInfixExpression(
         std::string rightVal = objectToString(right);
 
         if (operator_ == "&") {
-            return std::make_shared<String>(leftVal + rightVal);
+            return MakeRef<String>(leftVal + rightVal);
         }
     }
     catch (const std::runtime_error& e) {
-        return std::make_shared<ErrorObject>(e.what());
+        return MakeRef<ErrorObject>(e.what());
     }
-    return std::make_shared<ErrorObject>("unknown operator: " + operator_ + " for types " + left->Type() + " and " + right->Type());
+    return MakeRef<ErrorObject>("unknown operator: " + std::string(operator_) + " for types " + left.Type() + " and " + right.Type());
 }
 
-std::string getObjectStringValue(std::shared_ptr<Object> obj) {
-    if (obj->Type() == ObjectTypeToString(ObjectType_::INTEGER_OBJ)) {
-        return std::to_string(dynamic_cast<IntegerObject*>(obj.get())->Value);
+std::string getObjectStringValue(const Value& obj) {
+    if (obj.IsInteger()) {
+        return std::to_string(obj.AsInteger());
     }
-    else if (obj->Type() == ObjectTypeToString(ObjectType_::FLOAT_OBJ)) {
-        return std::to_string(dynamic_cast<FloatObject*>(obj.get())->Value);
+    else if (obj.IsFloat()) {
+        return std::to_string(obj.AsFloat());
     }
-    else if (obj->Type() == ObjectTypeToString(ObjectType_::STRING_OBJ)) {
-        return dynamic_cast<String*>(obj.get())->Value;
+    else if (auto str = obj.As<String>()) {
+        return str->Value;
     }
-    else if (obj->Type() == ObjectTypeToString(ObjectType_::CHAR_OBJ)) {
-        return std::string(1, dynamic_cast<Char*>(obj.get())->Value);
+    else if (obj.IsChar()) {
+        return std::string(1, obj.AsChar());
     }
     return "";
 }
 
-static std::shared_ptr<Object> evalBoolInfixExpression(
-    const std::string& operator_,
-    std::shared_ptr<Object> left,
-    std::shared_ptr<Object> right) {
+static Value evalBoolInfixExpression(
+    std::string_view operator_,
+    const Value& left,
+    const Value& right) {
 
     std::string leftVal;
-    if (left->Type() == ObjectTypeToString(ObjectType_::BOOLEAN_OBJ)) {
-        leftVal = dynamic_cast<BooleanObject*>(left.get())->Value ? "TRUE" : "FALSE";
+    if (left.IsBoolean()) {
+        leftVal = left.AsBoolean() ? "TRUE" : "FALSE";
     }
     else {
         leftVal = getObjectStringValue(left);
         if (leftVal.empty()) {
-            return std::make_shared<ErrorObject>("left-hand operand of & must be boolean, integer, float, string, or char, got " + left->Type());
+            return MakeRef<ErrorObject>("left-hand operand of & must be boolean, integer, float, string, or char, got " + left.Type());
         }
     }
 
     std::string rightVal;
-    if (right->Type() == ObjectTypeToString(ObjectType_::BOOLEAN_OBJ)) {
-        rightVal = dynamic_cast<BooleanObject*>(right.get())->Value ? "TRUE" : "FALSE";
+    if (right.IsBoolean()) {
+        rightVal = right.AsBoolean() ? "TRUE" : "FALSE";
     }
     else {
         rightVal = getObjectStringValue(right);
         if (rightVal.empty()) {
-            return std::make_shared<ErrorObject>("right-hand operand of & must be boolean, integer, float, string, or char, got " + right->Type());
+            return MakeRef<ErrorObject>("right-hand operand of & must be boolean, integer, float, string, or char, got " + right.Type());
         }
     }
 
     if (operator_ == "&") {
-        return std::make_shared<String>(leftVal + rightVal);
+        return MakeRef<String>(leftVal + rightVal);
     }
-    return std::make_shared<ErrorObject>("unknown operator: " + operator_ + " for types " + left->Type() + " and " + right->Type());
+    return MakeRef<ErrorObject>("unknown operator: " + std::string(operator_) + " for types " + left.Type() + " and " + right.Type());
 }
 
-static std::shared_ptr<Object> evalInfixExpression(
-    const std::string& operator_,
-    std::shared_ptr<Object> left,
-    std::shared_ptr<Object> right) {
+// One switch label per (left, right) combination of operand types
+static constexpr int tagPair(ObjectType_ left, ObjectType_ right) {
+    return static_cast<int>(left) << 8 | static_cast<int>(right);
+}
+
+Value evalInfixExpression(
+    std::string_view operator_,
+    const Value& left,
+    const Value& right) {
 
     //std::cout << "Infix" << std::endl;
 
-    if (left->Type() == ObjectTypeToString(ObjectType_::INTEGER_OBJ) && 
-        right->Type() == ObjectTypeToString(ObjectType_::INTEGER_OBJ)) {
-        return evalIntegerInfixExpression(operator_, std::move(left), std::move(right));
-    }
+    using enum ObjectType_;
+    switch (tagPair(left.Tag(), right.Tag())) {
+    case tagPair(INTEGER_OBJ, INTEGER_OBJ):
+        return evalIntegerInfixExpression(operator_, left, right);
+
     // Int | Float vs Float
-    else if ((left->Type() == ObjectTypeToString(ObjectType_::INTEGER_OBJ) &&
-        right->Type() == ObjectTypeToString(ObjectType_::FLOAT_OBJ)) ||
-        (left->Type() == ObjectTypeToString(ObjectType_::FLOAT_OBJ) &&
-            right->Type() == ObjectTypeToString(ObjectType_::INTEGER_OBJ)) ||
-        (left->Type() == ObjectTypeToString(ObjectType_::FLOAT_OBJ) &&
-            right->Type() == ObjectTypeToString(ObjectType_::FLOAT_OBJ))) {
-        return evalFloatInfixExpression(operator_, std::move(left), std::move(right));
-    }
-    //// String vs String | Char
-    //else if (
-    //    (left->Type() == ObjectTypeToString(ObjectType_::STRING_OBJ) &&
-    //        (right->Type() == ObjectTypeToString(ObjectType_::STRING_OBJ) ||
-    //        right->Type() == ObjectTypeToString(ObjectType_::CHAR_OBJ))) ||
-    //    (left->Type() == ObjectTypeToString(ObjectType_::CHAR_OBJ) &&
-    //        (right->Type() == ObjectTypeToString(ObjectType_::STRING_OBJ) ||
-    //        right->Type() == ObjectTypeToString(ObjectType_::CHAR_OBJ)))
-    //    ) {
-    //    return evalStringInfixExpression(operator_, std::move(left), std::move(right));
-    //}
+    case tagPair(INTEGER_OBJ, FLOAT_OBJ):
+    case tagPair(FLOAT_OBJ, INTEGER_OBJ):
+    case tagPair(FLOAT_OBJ, FLOAT_OBJ):
+        return evalFloatInfixExpression(operator_, left, right);
+
     // String vs Any Primitive Type
-    else if (
-        (left->Type() == ObjectTypeToString(ObjectType_::STRING_OBJ) ||
-            left->Type() == ObjectTypeToString(ObjectType_::CHAR_OBJ)) &&
-        (right->Type() == ObjectTypeToString(ObjectType_::STRING_OBJ) ||
-            right->Type() == ObjectTypeToString(ObjectType_::CHAR_OBJ) ||
-            right->Type() == ObjectTypeToString(ObjectType_::INTEGER_OBJ) ||
-            right->Type() == ObjectTypeToString(ObjectType_::FLOAT_OBJ) ||
-            right->Type() == ObjectTypeToString(ObjectType_::BOOLEAN_OBJ)) ||
-        (right->Type() == ObjectTypeToString(ObjectType_::STRING_OBJ) ||
-            right->Type() == ObjectTypeToString(ObjectType_::CHAR_OBJ)) &&
-        (left->Type() == ObjectTypeToString(ObjectType_::INTEGER_OBJ) ||
-            left->Type() == ObjectTypeToString(ObjectType_::FLOAT_OBJ) ||
-            left->Type() == ObjectTypeToString(ObjectType_::BOOLEAN_OBJ))
-        ) {
-        return evalStringInfixExpression(operator_, std::move(left), std::move(right));
-    }
+    case tagPair(STRING_OBJ, STRING_OBJ):
+    case tagPair(STRING_OBJ, CHAR_OBJ):
+    case tagPair(STRING_OBJ, INTEGER_OBJ):
+    case tagPair(STRING_OBJ, FLOAT_OBJ):
+    case tagPair(STRING_OBJ, BOOLEAN_OBJ):
+    case tagPair(CHAR_OBJ, STRING_OBJ):
+    case tagPair(CHAR_OBJ, CHAR_OBJ):
+    case tagPair(CHAR_OBJ, INTEGER_OBJ):
+    case tagPair(CHAR_OBJ, FLOAT_OBJ):
+    case tagPair(CHAR_OBJ, BOOLEAN_OBJ):
+    case tagPair(INTEGER_OBJ, STRING_OBJ):
+    case tagPair(INTEGER_OBJ, CHAR_OBJ):
+    case tagPair(FLOAT_OBJ, STRING_OBJ):
+    case tagPair(FLOAT_OBJ, CHAR_OBJ):
+    case tagPair(BOOLEAN_OBJ, STRING_OBJ):
+    case tagPair(BOOLEAN_OBJ, CHAR_OBJ):
+        return evalStringInfixExpression(operator_, left, right);
+
     // Primitive Type vs Bool
-    else if (
-        (left->Type() == ObjectTypeToString(ObjectType_::BOOLEAN_OBJ) && 
-            right->Type() == ObjectTypeToString(ObjectType_::BOOLEAN_OBJ)) ||
-        (left->Type() == ObjectTypeToString(ObjectType_::BOOLEAN_OBJ) &&
-            (right->Type() == ObjectTypeToString(ObjectType_::INTEGER_OBJ) ||
-                right->Type() == ObjectTypeToString(ObjectType_::FLOAT_OBJ) ||
-                right->Type() == ObjectTypeToString(ObjectType_::STRING_OBJ) ||
-                right->Type() == ObjectTypeToString(ObjectType_::CHAR_OBJ))) ||
-        (right->Type() == ObjectTypeToString(ObjectType_::BOOLEAN_OBJ) &&
-            (left->Type() == ObjectTypeToString(ObjectType_::INTEGER_OBJ) ||
-                left->Type() == ObjectTypeToString(ObjectType_::FLOAT_OBJ) ||
-                left->Type() == ObjectTypeToString(ObjectType_::STRING_OBJ) ||
-                left->Type() == ObjectTypeToString(ObjectType_::CHAR_OBJ)))
-        ) {
-        return evalBoolInfixExpression(operator_, std::move(left), std::move(right));
-    }
-    else if (operator_ == "==") {
-        auto leftVal = dynamic_cast<BooleanObject*>(left.get())->Value;
-        auto rightVal = dynamic_cast<BooleanObject*>(right.get())->Value;
-        return std::make_unique<BooleanObject>(leftVal == rightVal);
-    }
-    else if (operator_ == "<>") {
-        auto leftVal = dynamic_cast<BooleanObject*>(left.get())->Value;
-        auto rightVal = dynamic_cast<BooleanObject*>(right.get())->Value;
-        return std::make_unique<BooleanObject>(leftVal != rightVal);
-    }
-    else if (left->Type() != right->Type()) {
-        return newError("Type mismatch: ", left->Type(), operator_, right->Type());
-    }
-    else {
-        return newError("Unknown operator: ", left->Type(), operator_, right->Type());
+    case tagPair(BOOLEAN_OBJ, BOOLEAN_OBJ):
+    case tagPair(BOOLEAN_OBJ, INTEGER_OBJ):
+    case tagPair(BOOLEAN_OBJ, FLOAT_OBJ):
+    case tagPair(INTEGER_OBJ, BOOLEAN_OBJ):
+    case tagPair(FLOAT_OBJ, BOOLEAN_OBJ):
+        return evalBoolInfixExpression(operator_, left, right);
+
+    default:
+        break;
     }
-}
 
-static bool isTruthy(const std::shared_ptr<Object>& obj) {
-    if (dynamic_cast<NullObject*>(obj.get()) != nullptr) {
-        return false;
+    if (left.Type() != right.Type()) {
+        return newError("Type mismatch: ", left.Type(), operator_, right.Type());
     }
-    else if (auto boolVal = dynamic_cast<BooleanObject*>(obj.get())) {
-        if (boolVal->Value == true) {
-            return true;
-        }
-        else if (boolVal->Value == false) {
-            return false;
-        }
+    else {
+        return newError("Unknown operator: ", left.Type(), operator_, right.Type());
     }
-    // For any other object type, consider it truthy
-    return true;
 }
 
-static std::shared_ptr<Object> evalIfExpression(const IfExpression* ie, const std::shared_ptr<Environment>& env) {
+static Value evalIfExpression(const IfExpression* ie, const Ref<Environment>& env) {
     // Iterate over each condition and block pair
     for (const auto& branch : ie->Branches) {
         auto condition = Eval(branch.first.get(), env);
@@ -532,8 +445,7 @@ static std::shared_ptr<Object> evalIfExpression(const IfExpression* ie, const st
             return condition;
         }
 
-        incrementEvaluatorLine();
-        if (isTruthy(condition)) {
+        if (condition.IsTruthy()) {
             // If the condition is true, evaluate the corresponding consequence block
             return Eval(branch.second.get(), env);
         }
@@ -541,20 +453,28 @@ static std::shared_ptr<Object> evalIfExpression(const IfExpression* ie, const st
 
     // If no condition is true and there is an alternative block, evaluate it
     if (ie->Alternative) {
-        incrementEvaluatorLine();
         return Eval(ie->Alternative.get(), env);
     }
 
-    // If no condition is true and there is no alternative block, return NullObject
-    incrementEvaluatorLine();
-    return std::make_shared<NullObject>();
+    // If no condition is true and there is no alternative block, return NULL
+    return Value::Null();
 }
 
 
-static std::shared_ptr<Object> evalWhileExpression(const WhileExpression* we, const std::shared_ptr<Environment>& env) {
+static Value evalWhileExpression(const WhileExpression* we, const Ref<Environment>& env) {
+
+    // Every iteration starts from an empty frame, but the same one is reused
+    // unless the previous iteration let something keep it (a function defined
+    // in the body closes over it).
+    Ref<Environment> loopEnv;
 
     while (true) {
-        auto loopEnv = std::make_shared<Environment>(env);
+        if (!loopEnv || loopEnv.use_count() > 1) {
+            loopEnv = MakeRef<Environment>(env, we->NumSlots);
+        }
+        else {
+            loopEnv->Clear();
+        }
 
         auto condition = Eval(we->Condition.get(), loopEnv);
         if (isError(condition)) {
@@ -562,65 +482,91 @@ static std::shared_ptr<Object> evalWhileExpression(const WhileExpression* we, co
         }
 
         // Break if condition is false
-        if (!isTruthy(condition)) {
-            break; 
+        if (!condition.IsTruthy()) {
+            break;
         }
 
-        // Evaluate the loop body 
-        auto result = Eval(we->Body.get(), loopEnv); 
+        // Evaluate the loop body
+        auto result = Eval(we->Body.get(), loopEnv);
         if (isError(result)) {
             return result;
         }
 
-        loopEnv.reset();
-
         // TODO: Maybe implement a break
     }
 
-    return std::make_shared<NullObject>(); 
+    return Value::Null();
 }
 
 
-static std::shared_ptr<Object> evalBlockStatement(const BlockStatement* block, const std::shared_ptr<Environment>& env) {
-    std::shared_ptr<Object> result = nullptr;
+static Value evalBlockStatement(const BlockStatement* block, const Ref<Environment>& env) {
+    Runtime& runtime = CurrentRuntime();
+    Value result;
 
     for (const auto& statement : block->Statements) {
-        incrementEvaluatorLine();
+        runtime.Gc.MaybeCollect(); // Nothing is half built between statements
+        ++runtime.EvaluatedStatements;
         result = Eval(statement.get(), env);
 
-        if (result != nullptr) {
-            std::string rt = result->Type();
-            if (rt == ObjectTypeToString(ObjectType_::RETURN_VALUE_OBJ) || rt == ObjectTypeToString(ObjectType_::ERROR_OBJ)) {
-                return result;
-            }
+        ObjectType_ rt = result.Tag();
+        if (rt == ObjectType_::RETURN_VALUE_OBJ || rt == ObjectType_::ERROR_OBJ) {
+            setErrorLine(result, statement.get());
+            return result;
         }
     }
 
     return result;
 }
 
-static std::shared_ptr<Object> evalIdentifier(const Identifier* node, const std::shared_ptr<Environment>& env) {
-    auto val = env->GetObject(node->Value);
+// Variables the Resolver addressed are indexed straight out of their frame.
+// Anything else can only be a global declared after the code naming it was
+// resolved (an earlier REPL line), so it is looked up by name.
+static Value lookupVariable(const Identifier* ident, const Ref<Environment>& env) {
+    if (ident->Slot >= 0) {
+        return env->GetValue(ident->Depth, ident->Slot);
+    }
+    return env->GetValue(std::string(ident->Value));
+}
+
+static TokenType lookupType(const Identifier* ident, const Ref<Environment>& env) {
+    if (ident->Slot >= 0) {
+        return env->GetType(ident->Depth, ident->Slot);
+    }
+    return env->GetType(std::string(ident->Value));
+}
+
+static void setVariable(const Identifier* ident, TokenType type, Value val, const Ref<Environment>& env) {
+    if (ident->Slot >= 0) {
+        env->Set(ident->Depth, ident->Slot, type, std::move(val));
+    }
+    else {
+        env->Set(std::string(ident->Value), type, std::move(val));
+    }
+}
+
+static Value evalIdentifier(const Identifier* node, const Ref<Environment>& env) {
+    auto val = lookupVariable(node, env);
     if (val) {
-        return val; 
+        return val;
     }
 
-    auto it = builtins.find(node->Value);
+    const BuiltinTable& builtins = CurrentRuntime().Builtins;
+    auto it = builtins.find(std::string(node->Value));
     if (it != builtins.end()) {
-        return it->second; 
+        return it->second;
     }
 
-    return newError("Identifier not found '" + node->Value + "'");
+    return newError("Identifier not found '" + std::string(node->Value) + "'");
 }
 
-static std::vector<std::shared_ptr<Object>> evalExpressions(const std::vector<std::unique_ptr<Expression>>& exps, const std::shared_ptr<Environment>& env) {
-    std::vector<std::shared_ptr<Object>> results;
+static std::vector<Value> evalExpressions(const std::vector<std::unique_ptr<Expression>>& exps, const Ref<Environment>& env) {
+    std::vector<Value> results;
 
     for (const auto& expr : exps) {
         auto evaluated = Eval(expr.get(), env);
         if (isError(evaluated)) {
             // Immediately return a vector containing just this error
-            std::vector<std::shared_ptr<Object>> result;
+            std::vector<Value> result;
             result.push_back(std::move(evaluated));
 
             return result;
@@ -631,131 +577,230 @@ static std::vector<std::shared_ptr<Object>> evalExpressions(const std::vector<st
     return results;
 }
 
-static std::shared_ptr<Environment> extendFunctionEnv(const Function& fn, const std::vector<std::shared_ptr<Object>>& args) {
-    auto extendedEnv = std::make_shared<Environment>(fn.Env);
+bool isScannable(TokenType type) {
+    return type == INT || type == FLOAT || type == BOOL || type == STRING || type == CHAR;
+}
+
+// Numbers accept what std::stoi did: leading blanks, a sign, and trailing text
+// that is ignored
+template<typename T>
+static Value scanNumber(TokenType type, std::string_view input, T& number) {
+    const char* first = input.data();
+    const char* last = input.data() + input.size();
+    while (first != last && std::isspace(static_cast<unsigned char>(*first))) {
+        ++first;
+    }
+    if (first != last && *first == '+') {
+        ++first;
+    }
+
+    auto [ptr, ec] = std::from_chars(first, last, number);
+    if (ec == std::errc::invalid_argument) {
+        return MakeRef<ErrorObject>("Invalid input for type " + std::string(TokenTypeName(type)));
+    }
+    if (ec == std::errc::result_out_of_range) {
+        return MakeRef<ErrorObject>("Input out of range for type " + std::string(TokenTypeName(type)));
+    }
+    return nullptr;
+}
+
+Value scanValue(TokenType type, std::string_view input) {
+    if (type == INT) {
+        int number = 0;
+        auto error = scanNumber(type, input, number);
+        return error ? error : Value::Integer(number);
+    }
+    else if (type == FLOAT) {
+        double number = 0;
+        auto error = scanNumber(type, input, number);
+        return error ? error : Value::Float(number);
+    }
+    else if (type == STRING) {
+        return MakeRef<String>(std::string(input));
+    }
+    else if (type == BOOL) {
+        return Value::Boolean(input == "TRUE" || input == "1");
+    }
+    else if (type == CHAR) {
+        if (input.length() != 1) {
+            return MakeRef<ErrorObject>("Invalid input size for CHAR type. Expected a single character.");
+        }
+        return Value::Char(input.front());
+    }
+    return MakeRef<ErrorObject>("Unsupported type for SCAN: " + std::string(TokenTypeName(type)));
+}
+
+// SCAN assigns to the variables named by its arguments, so it works on the
+// argument expressions rather than on their values. The Resolver has already
+// bound each of them to its slot.
+static Value evalScan(const std::vector<std::unique_ptr<Expression>>& exps, const Ref<Environment>& env) {
+    for (const auto& expr : exps) {
+        auto ident = expr->As<Identifier>();
+        auto varType = ident ? lookupType(ident, env) : NONE;
+
+        if (!isScannable(varType)) {
+            return MakeRef<ErrorObject>("Unsupported type for SCAN: " + std::string(TokenTypeName(varType)));
+        }
+
+        std::string_view input;
+        StandardOutput().Flush(); // Prompts have to be visible before we wait
+        StandardInput().ReadLine(input);
+
+        auto value = scanValue(varType, input);
+        if (isError(value)) {
+            return value;
+        }
+        setVariable(ident, varType, std::move(value), env);
+    }
+    // Return 1 for success code
+    return Value::Integer(1);
+}
+
+static Ref<Environment> extendFunctionEnv(const Function& fn, const std::vector<Value>& args) {
+    auto extendedEnv = MakeRef<Environment>(fn.Env, fn.NumSlots);
 
     for (size_t i = 0; i < fn.Parameters.size(); ++i) {
-        extendedEnv->Set(fn.Parameters[i]->Name->Value, Token(FUNCTION, "FUNCTION"), args[i]);
+        setVariable(fn.Parameters[i]->Name.get(), FUNCTION, args[i], extendedEnv);
     }
 
     return extendedEnv;
 }
 
-static std::shared_ptr<Object> unwrapReturnValue(std::shared_ptr<Object>& obj) {
-    if (auto returnValue = dynamic_cast<ReturnValue*>(obj.get())) {
+static Value unwrapReturnValue(Value& obj) {
+    if (auto returnValue = obj.As<ReturnValue>()) {
         return returnValue->TakeValue();
     }
     return obj;
 }
 
-static std::shared_ptr<Object> applyFunction(std::shared_ptr<Object>& fn, const std::vector<std::shared_ptr<Object>>& args, std::shared_ptr<Environment> env) {
-    if (auto function = std::dynamic_pointer_cast<Function>(fn)) {
+static Value applyFunction(const Value& fn, const std::vector<Value>& args, const Ref<Environment>& env) {
+    if (auto function = fn.As<Function>()) {
         auto extendedEnv = extendFunctionEnv(*function, args);
         auto evaluated = Eval(function->Body.get(), extendedEnv);
         return unwrapReturnValue(evaluated);
     }
-    else if (auto builtin = std::dynamic_pointer_cast<Builtin>(fn)) {
-        return builtin->Fn(args, env); // Call the builtin function with args
+    else if (auto builtin = fn.As<Builtin>()) {
+        return builtin->Fn(args, env.get()); // Call the builtin function with args
     }
     else {
-        return std::make_shared<ErrorObject>("not a function: " + fn->Inspect());
+        return MakeRef<ErrorObject>("not a function: " + fn.Inspect());
     }
 }
 
-static bool isTypeCompatible(const TokenType declaredType, const std::shared_ptr<Object>& value) {
+bool isTypeCompatible(const TokenType declaredType, const Value& value) {
     if (!value) return false; // null check for safety
-    if (declaredType == INT && dynamic_cast<IntegerObject*>(value.get())) return true;
-    if (declaredType == FLOAT && dynamic_cast<FloatObject*>(value.get())) return true;
-    if (declaredType == CHAR && dynamic_cast<Char*>(value.get())) return true;
-    if (declaredType == BOOL && dynamic_cast<BooleanObject*>(value.get())) return true;
-    if (declaredType == STRING && dynamic_cast<String*>(value.get())) return true;
+    if (declaredType == INT && value.IsInteger()) return true;
+    if (declaredType == FLOAT && value.IsFloat()) return true;
+    if (declaredType == CHAR && value.IsChar()) return true;
+    if (declaredType == BOOL && value.IsBoolean()) return true;
+    if (declaredType == STRING && value.As<String>()) return true;
     return false;
 }
 
-std::shared_ptr<Object> Eval(const Node* node, const std::shared_ptr<Environment>& env) {
-    if (auto programNode = dynamic_cast<const Program*>(node)) {
+Value Eval(const Node* node, const Ref<Environment>& env) {
+    if (node == nullptr) {
+        return nullptr;
+    }
+
+    switch (node->Kind) {
+    case NodeKind::Program: {
+        auto programNode = static_cast<const Program*>(node);
         return evalProgram(programNode->Statements, env);
     }
-    else if (auto markerStmt = dynamic_cast<const MarkerStatement*>(node)) {
-        incrementEvaluatorLine();
+    case NodeKind::MarkerStatement: {
+        break;
     }
-    else if (auto exprStmtNode = dynamic_cast<const ExpressionStatement*>(node)) { // Must increment line number
+    case NodeKind::ExpressionStatement: {
+        auto exprStmtNode = static_cast<const ExpressionStatement*>(node);
         if (exprStmtNode->token.Type == FUNCTION && exprStmtNode->name) {
             auto val = Eval(exprStmtNode->Expression_.get(), env);
             if (isError(val)) {
                 return val;
             }
-            env->Set(exprStmtNode->name->TokenLiteral(), exprStmtNode->token, val);
+            if (auto name = exprStmtNode->name->As<Identifier>()) {
+                setVariable(name, exprStmtNode->token.Type, val, env);
+            }
         }
         else {
-            incrementEvaluatorLine();
             return Eval(exprStmtNode->Expression_.get(), env);
         }
-    } 
-    else if (auto intLit = dynamic_cast<const IntegerLiteral*>(node)) {
-        return std::make_unique<IntegerObject>(intLit->Value);
+        break;
     }
-    else if (auto floatLit = dynamic_cast<const FloatLiteral*>(node)) {
-        return std::make_unique<FloatObject>(floatLit->Value);
+    case NodeKind::IntegerLiteral: {
+        auto intLit = static_cast<const IntegerLiteral*>(node);
+        return Value::Integer(intLit->Value);
     }
-    else if (auto bl = dynamic_cast<const Boolean*>(node)) {
-        return std::make_unique<BooleanObject>(bl->Value);
+    case NodeKind::FloatLiteral: {
+        auto floatLit = static_cast<const FloatLiteral*>(node);
+        return Value::Float(floatLit->Value);
     }
-    else if (auto str = dynamic_cast<const StringLiteral*>(node)) {
-        return std::make_unique<String>(str->Value);
+    case NodeKind::Boolean: {
+        auto bl = static_cast<const Boolean*>(node);
+        return Value::Boolean(bl->Value);
     }
-    else if (auto ch = dynamic_cast<const CharLiteral*>(node)) {
-        return std::make_unique<Char>(ch->Value);
+    case NodeKind::StringLiteral: {
+        auto str = static_cast<const StringLiteral*>(node);
+        return str->Constant;
     }
-    else if (auto prefixExpr = dynamic_cast<const PrefixExpression*>(node)) {
+    case NodeKind::CharLiteral: {
+        auto ch = static_cast<const CharLiteral*>(node);
+        return Value::Char(ch->Value);
+    }
+    case NodeKind::PrefixExpression: {
+        auto prefixExpr = static_cast<const PrefixExpression*>(node);
         auto right = Eval(prefixExpr->Right.get(), env);
         if (isError(right)) {
             return right;
         }
         return evalPrefixExpression(prefixExpr->Operator, right);
     }
-    else if (auto infixExpr = dynamic_cast<const InfixExpression*>(node)) {
+    case NodeKind::InfixExpression: {
+        auto infixExpr = static_cast<const InfixExpression*>(node);
         auto left = Eval(infixExpr->Left.get(), env);
-        //std::cout << left->Inspect() << std::endl;
+        //std::cout << left.Inspect() << std::endl;
         if (isError(left)) {
             return left;
         }
         auto right = Eval(infixExpr->Right.get(), env);
-        //std::cout << right->Inspect() << std::endl;
+        //std::cout << right.Inspect() << std::endl;
         if (isError(right)) {
             return right;
         }
         return evalInfixExpression(infixExpr->Operator, left, right);
     }
-    else if (auto blockStmt = dynamic_cast<const BlockStatement*>(node)) {
+    case NodeKind::BlockStatement: {
+        auto blockStmt = static_cast<const BlockStatement*>(node);
         return evalBlockStatement(blockStmt, env);
     }
-    else if (auto ifExpr = dynamic_cast<const IfExpression*>(node)) {
+    case NodeKind::IfExpression: {
+        auto ifExpr = static_cast<const IfExpression*>(node);
         return evalIfExpression(ifExpr, env);
     }
-    else if (auto whileExpr = dynamic_cast<const WhileExpression*>(node)) {
+    case NodeKind::WhileExpression: {
+        auto whileExpr = static_cast<const WhileExpression*>(node);
         return evalWhileExpression(whileExpr, env);
     }
-    else if (const auto* returnStmt = dynamic_cast<const ReturnStatement*>(node)) {
+    case NodeKind::ReturnStatement: {
+        auto returnStmt = static_cast<const ReturnStatement*>(node);
         auto val = Eval(returnStmt->ReturnValue.get(), env);
         if (isError(val)) {
             return val;
         }
-        return std::make_unique<ReturnValue>(val);
+        return MakeRef<ReturnValue>(val);
     }
-    else if (auto multiStmt = dynamic_cast<const MultiTypedDeclStatement*>(node)) {
-        incrementEvaluatorLine();
+    case NodeKind::MultiTypedDeclStatement: {
+        auto multiStmt = static_cast<const MultiTypedDeclStatement*>(node);
         //std::cout << multiStmt->token.Literal << std::endl;
         for (size_t i = 0; i < multiStmt->Names.size(); ++i) {
             auto& name = multiStmt->Names[i];
-            std::shared_ptr<Object> value;
+            Value value;
 
             // Check if there is a corresponding value for this name
             if (i < multiStmt->Values.size() && multiStmt->Values[i]) {
                 value = Eval(multiStmt->Values[i].get(), env); // Evaluate the expression associated with the name
-                if (!isTypeCompatible(multiStmt->token.Literal, value)) {
-                    //return std::make_shared<ErrorObject>("Type mismatch for '" + name->Value + "': expected " + multiStmt->token.Literal + ", got " + value->Type());
-                    logError("Type mismatch for '" + name->Value + "': expected " + multiStmt->token.Literal + ", got " + value->Type());
+                if (!isTypeCompatible(multiStmt->token.Type, value)) {
+                    //return MakeRef<ErrorObject>("Type mismatch for '" + name->Value + "': expected " + multiStmt->token.Literal + ", got " + value.Type());
+                    logError("Type mismatch for '" + std::string(name->Value) + "': expected " + std::string(multiStmt->token.Literal) + ", got " + value.Type());
                     continue;
                 }
                 if (isError(value)) {
@@ -763,40 +808,43 @@ std::shared_ptr<Object> Eval(const Node* node, const std::shared_ptr<Environment
                 }
             }
             else {
-                value = std::make_shared<NullObject>(); // Default to Null if no value provided
+                value = Value::Null(); // Default to Null if no value provided
             }
 
             // Assuming the name is an Identifier and has a string value field
             if (name) {
-                env->Set(name->Value, multiStmt->token, value);
+                setVariable(name.get(), multiStmt->token.Type, value, env);
             }
             else {
                 // Error handling if name is somehow null
-                return std::make_shared<ErrorObject>("Invalid variable name in declaration.");
+                return MakeRef<ErrorObject>("Invalid variable name in declaration.");
             }
         }
+        break;
     }
-
-    else if (const auto* typedDeclStmt = dynamic_cast<const TypedDeclStatement*>(node)) {
-        incrementEvaluatorLine();
+    case NodeKind::TypedDeclStatement: {
+        auto typedDeclStmt = static_cast<const TypedDeclStatement*>(node);
         if (typedDeclStmt->Value) {
             auto val = Eval(typedDeclStmt->Value.get(), env);
             if (isError(val)) {
                 return val;
             }
             if (!isTypeCompatible(typedDeclStmt->token.Type, val)) {
-                return std::make_shared<ErrorObject>("Type mismatch: Expected " + typedDeclStmt->token.Literal + " but got " + val->Type());
+                return MakeRef<ErrorObject>("Type mismatch: Expected " + std::string(typedDeclStmt->token.Literal) + " but got " + val.Type());
             }
-            env->Set(typedDeclStmt->Name->Value, typedDeclStmt->token, val);
+            setVariable(typedDeclStmt->Name.get(), typedDeclStmt->token.Type, val, env);
         }
         else {
-            env->Set(typedDeclStmt->Name->Value, typedDeclStmt->token, std::make_unique<NullObject>());
+            setVariable(typedDeclStmt->Name.get(), typedDeclStmt->token.Type, Value::Null(), env);
         }
+        break;
     }
-    else if (const auto* ident = dynamic_cast<const Identifier*>(node)) {
+    case NodeKind::Identifier: {
+        auto ident = static_cast<const Identifier*>(node);
         return evalIdentifier(ident, env);
     }
-    else if (const auto* funcLit = dynamic_cast<const FunctionLiteral*>(node)) {
+    case NodeKind::FunctionLiteral: {
+        auto funcLit = static_cast<const FunctionLiteral*>(node);
         std::vector<std::unique_ptr<TypedDeclStatement>> params;
         for (const auto& p : funcLit->Parameters) {
             params.push_back(std::make_unique<TypedDeclStatement>(p->token, std::move(p->Name)));
@@ -805,30 +853,40 @@ std::shared_ptr<Object> Eval(const Node* node, const std::shared_ptr<Environment
         auto body = std::make_unique<BlockStatement>(funcLit->Body->token);
         body->Statements = std::move(funcLit->Body->Statements);
 
-        auto fnObject = std::make_shared<Function>(funcLit->type, std::move(funcLit->CallName->clone()), std::move(params), std::move(body), env);
-        
-        env->Set(fnObject->CallName->TokenLiteral(), Token(FUNCTION, "FUNCTION"), fnObject);
+        auto fnObject = MakeRef<Function>(funcLit->type, std::move(funcLit->CallName->clone()), std::move(params), std::move(body), env);
+        fnObject->Src = funcLit->Src; // The body's tokens point into the source
+        fnObject->NumSlots = funcLit->NumSlots;
+
+        if (auto name = fnObject->CallName->As<Identifier>()) {
+            setVariable(name, FUNCTION, fnObject, env);
+        }
 
         return fnObject;
     }
-    else if (const auto* callExpr = dynamic_cast<const CallExpression*>(node)) {
+    case NodeKind::CallExpression: {
+        auto callExpr = static_cast<const CallExpression*>(node);
         auto function = Eval(callExpr->Function.get(), env);
-        
+
         if (isError(function)) {
-            std::cout << function->Inspect() << std::endl;
+            StandardOutput().Write(function.Inspect()).EndLine();
             return function;
         }
-        
+
         auto args = evalExpressions(callExpr->Arguments, env);
         if (!args.empty() && isError(args.front())) {
             return std::move(args.front());
         }
 
+        if (function.IsObject() && function.AsObject() == CurrentRuntime().Scan) {
+            return evalScan(callExpr->Arguments, env);
+        }
+
         auto result = applyFunction(function, args, env);
 
         return result;
     }
-    else if (const auto* assignExpr = dynamic_cast<const AssignExpression*>(node)) {
+    case NodeKind::AssignExpression: {
+        auto assignExpr = static_cast<const AssignExpression*>(node);
         if (assignExpr->names.empty()) {
             return newError("Assignment without a variable name.");
         }
@@ -838,36 +896,38 @@ std::shared_ptr<Object> Eval(const Node* node, const std::shared_ptr<Environment
         }
 
         for (auto it = assignExpr->names.rbegin(); it != assignExpr->names.rend(); ++it) {
+            auto ident = (*it)->As<Identifier>();
             auto identifier = (*it)->TokenLiteral();
-            auto expectedType = env->GetType(identifier);  // Retrieve expected type for the identifier
+            auto expectedType = ident ? lookupType(ident, env) : NONE;  // Retrieve expected type for the identifier
 
             // If the identifier exists but types don't match, return an error
             if ((
-                expectedType.Literal == INT   || 
-                expectedType.Literal == CHAR  ||
-                expectedType.Literal == FLOAT ||
-                expectedType.Literal == BOOL  ||
-                expectedType.Literal == STRING 
-                ) && !isTypeCompatible(expectedType.Literal, value)) {
-                return newError("Type mismatch for '" + identifier + "': expected " + expectedType.Literal + ", got " + value->Type());
+                expectedType == INT   ||
+                expectedType == CHAR  ||
+                expectedType == FLOAT ||
+                expectedType == BOOL  ||
+                expectedType == STRING
+                ) && !isTypeCompatible(expectedType, value)) {
+                return newError("Type mismatch for '" + identifier + "': expected " + std::string(TokenTypeName(expectedType)) + ", got " + value.Type());
             }
 
             // If the identifier does not exist in the environment, return an error
             if (!(
-                expectedType.Literal == INT   ||
-                expectedType.Literal == CHAR  ||
-                expectedType.Literal == FLOAT ||
-                expectedType.Literal == BOOL  ||
-                expectedType.Literal == STRING
+                expectedType == INT   ||
+                expectedType == CHAR  ||
+                expectedType == FLOAT ||
+                expectedType == BOOL  ||
+                expectedType == STRING
                 )) {
                 return newError("Unknown Identifier: '" + identifier + "'");
             }
 
             // If types match, or no type information is required, set the new value
             //env->Set(identifier, Token("", ""), value);
-            env->Set(identifier, expectedType, value);
+            setVariable(ident, expectedType, value, env);
         }
         return value;
     }
+    }
     return nullptr;
-}
\ No newline at end of file
+}
@@ -6,5 +6,20 @@
 #include "AST.h"
 #include "Object.h"
 #include "Environment.h"
+#include "Resolver.h"
+#include "Output.h"
+#include "Input.h"
 #include "Lexer.h"
-std::shared_ptr<Object> Eval(const Node* node, const std::shared_ptr<Environment>& env);
\ No newline at end of file
+#include "Runtime.h"
+// Programs must go through Resolver::Resolve against the same environment first
+Value Eval(const Node* node, const Ref<Environment>& env);
+
+// The builtin functions, made afresh for every Runtime
+BuiltinTable MakeBuiltins();
+
+// Operator and type semantics, shared with the bytecode VM so both engines agree
+Value evalPrefixExpression(std::string_view operator_, const Value& right);
+Value evalInfixExpression(std::string_view operator_, const Value& left, const Value& right);
+bool isTypeCompatible(const TokenType declaredType, const Value& value);
+bool isScannable(TokenType type);
+Value scanValue(TokenType type, std::string_view input); // One line of SCAN input, or an error
@@ -0,0 +1,143 @@
+#include "Gc.h"
+
+#include <algorithm>
+#include <vector>
+
+Collectable::Collectable(bool tracked) : collector(tracked ? &DefaultCollector() : nullptr) {
+    if (collector != nullptr) {
+        collector->Track(this);
+    }
+}
+
+Collectable::~Collectable() {
+    if (collector != nullptr) {
+        collector->Untrack(this);
+    }
+}
+
+// Objects still alive are let go of, they are freed by their counts alone
+Collector::~Collector() {
+    for (Collectable* object = first; object != nullptr; object = object->next) {
+        object->collector = nullptr;
+    }
+}
+
+void Collector::Track(Collectable* object) {
+    object->next = first;
+    if (first != nullptr) {
+        first->prev = object;
+    }
+    first = object;
+
+    ++allocated;
+    peakTracked = std::max(peakTracked, ++tracked);
+}
+
+void Collector::Untrack(Collectable* object) {
+    if (object->prev != nullptr) {
+        object->prev->next = object->next;
+    }
+    else {
+        first = object->next;
+    }
+    if (object->next != nullptr) {
+        object->next->prev = object->prev;
+    }
+    --tracked;
+}
+
+std::size_t Collector::Collect() {
+    auto start = std::chrono::steady_clock::now();
+
+    // Start from the full count and take away the references tracked objects
+    // hold to each other
+    for (Collectable* object = first; object != nullptr; object = object->next) {
+        object->gcRefs = object->refs;
+        object->reachable = false;
+    }
+
+    class Subtract : public GcVisitor {
+    public:
+        explicit Subtract(Collector* collector) : collector(collector) {}
+
+        void Visit(const Collectable* child) override {
+            if (child != nullptr && child->collector == collector) {
+                --const_cast<Collectable*>(child)->gcRefs;
+            }
+        }
+
+    private:
+        Collector* collector;
+    } subtract(this);
+
+    for (Collectable* object = first; object != nullptr; object = object->next) {
+        object->Trace(subtract);
+    }
+
+    // Whatever is still referenced is held from outside, and so is everything
+    // it reaches
+    std::vector<Collectable*> pending;
+    for (Collectable* object = first; object != nullptr; object = object->next) {
+        if (object->gcRefs > 0) {
+            object->reachable = true;
+            pending.push_back(object);
+        }
+    }
+
+    class Mark : public GcVisitor {
+    public:
+        Mark(Collector* collector, std::vector<Collectable*>& pending) : collector(collector), pending(pending) {}
+
+        void Visit(const Collectable* child) override {
+            if (child != nullptr && child->collector == collector && !child->reachable) {
+                auto object = const_cast<Collectable*>(child);
+                object->reachable = true;
+                pending.push_back(object);
+            }
+        }
+
+    private:
+        Collector* collector;
+        std::vector<Collectable*>& pending;
+    } mark(this, pending);
+
+    while (!pending.empty()) {
+        Collectable* object = pending.back();
+        pending.pop_back();
+        object->Trace(mark);
+    }
+
+    // Hold on to the garbage while its loops are broken, so nothing in it is
+    // deleted while another part still points there, then let it all go
+    std::vector<Ref<Collectable>> garbage;
+    for (Collectable* object = first; object != nullptr; object = object->next) {
+        if (!object->reachable) {
+            garbage.emplace_back(object);
+        }
+    }
+    for (const auto& object : garbage) {
+        object->ClearRefs();
+    }
+    std::size_t count = garbage.size();
+    garbage.clear();
+
+    allocated = 0;
+    threshold = std::max(MinThreshold, tracked);
+
+    auto pause = std::chrono::steady_clock::now() - start;
+    ++collections;
+    freed += count;
+    totalPause += pause;
+    maxPause = std::max(maxPause, pause);
+    return count;
+}
+
+void Collector::PrintStats(std::ostream& out) const {
+    using Milliseconds = std::chrono::duration<double, std::milli>;
+
+    out << "GC: " << collections << " collections, "
+        << freed << " objects freed, "
+        << tracked << " tracked (peak " << peakTracked << "), "
+        << "pause total " << Milliseconds(totalPause).count() << " ms, "
+        << "max " << Milliseconds(maxPause).count() << " ms" << std::endl;
+}
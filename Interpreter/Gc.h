@@ -0,0 +1,102 @@
+#pragma once
+
+#include "Ref.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+class Collectable;
+class Collector;
+
+// Handed to Collectable::Trace, which calls Visit once for every Ref it holds
+class GcVisitor {
+public:
+    virtual void Visit(const Collectable* child) = 0;
+
+protected:
+    ~GcVisitor() = default;
+};
+
+// Base of everything the interpreter allocates and shares through Ref.
+// Reference counting frees almost all of it as soon as it is dropped, but a
+// FUNCTION keeps the environment it was declared in alive while that
+// environment holds the FUNCTION, and such a loop never drops to zero.
+//
+// The types that can close a loop are tracked: they are linked into the
+// Collector of the Runtime they were made in, which finds the groups that are
+// only referenced from inside the group and frees them.
+class Collectable : public RefCounted {
+public:
+    explicit Collectable(bool tracked);
+    virtual ~Collectable();
+
+    Collectable(const Collectable&) = delete;
+    Collectable& operator=(const Collectable&) = delete;
+
+    // Tracked types visit every Collectable they hold a Ref to
+    virtual void Trace(GcVisitor& /*visitor*/) const {}
+
+    // Drops those Refs. Only called on garbage, to break its loops.
+    virtual void ClearRefs() {}
+
+private:
+    friend class Collector;
+
+    Collector* collector; // Tracking this, or null
+    Collectable* prev = nullptr;
+    Collectable* next = nullptr;
+    uint32_t gcRefs = 0; // References from outside the tracked objects, during a collection
+    bool reachable = false;
+};
+
+// Cycle collector over the tracked objects, in the style of CPython's: an
+// object referenced more often than the tracked objects account for is held
+// from outside (a C++ local, a Value on the VM stack, an untracked object),
+// and everything reachable from such an object is alive. What is left is
+// only kept alive by its own loops.
+//
+// Nothing is ever scanned for roots, so a collection may run wherever no
+// object is half built. The evaluator offers one between statements.
+class Collector {
+public:
+    // Tracked objects created before the first collection is considered
+    static constexpr std::size_t MinThreshold = 10000;
+
+    Collector() = default;
+    ~Collector();
+
+    Collector(const Collector&) = delete;
+    Collector& operator=(const Collector&) = delete;
+
+    void Track(Collectable* object);
+    void Untrack(Collectable* object);
+
+    void MaybeCollect() {
+        if (allocated >= threshold) {
+            Collect();
+        }
+    }
+
+    // Frees the unreachable tracked objects and returns how many there were
+    std::size_t Collect();
+
+    // One line for --gc-stats
+    void PrintStats(std::ostream& out) const;
+
+private:
+    Collectable* first = nullptr;
+    std::size_t tracked = 0;
+    std::size_t peakTracked = 0;
+    std::size_t allocated = 0; // Tracked objects created since the last collection
+    std::size_t threshold = MinThreshold;
+
+    std::size_t collections = 0;
+    std::size_t freed = 0;
+    std::chrono::steady_clock::duration totalPause{};
+    std::chrono::steady_clock::duration maxPause{};
+};
+
+// The collector of the current Runtime (see Runtime.h), which new tracked
+// objects register with
+Collector& DefaultCollector();
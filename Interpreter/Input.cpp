@@ -0,0 +1,84 @@
+#include "Input.h"
+
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#include <io.h>
+#define isatty _isatty
+#define read _read
+#else
+#include <unistd.h>
+#endif
+
+Input::Input(int fd, bool buffered) : fd(fd), buffered(buffered) {}
+
+void Input::Reset() {
+    eof = false;
+    start = 0;
+    end = 0;
+}
+
+// Moves the unread tail to the front and reads another block after it.
+// Returns false when nothing more could be read.
+bool Input::fill() {
+    if (eof) {
+        return false;
+    }
+
+    if (start > 0) {
+        std::memmove(buffer.data(), buffer.data() + start, end - start);
+        end -= start;
+        start = 0;
+    }
+    if (buffer.size() - end < BlockSize) {
+        buffer.resize(end + BlockSize);
+    }
+
+    auto count = read(fd, buffer.data() + end, static_cast<unsigned int>(BlockSize));
+    if (count <= 0) {
+        eof = true;
+        return false;
+    }
+    end += static_cast<std::size_t>(count);
+    return true;
+}
+
+bool Input::ReadLine(std::string_view& line) {
+    if (!buffered) {
+        bool found = static_cast<bool>(std::getline(std::cin, lineCopy));
+        if (!found) {
+            lineCopy.clear();
+        }
+        line = lineCopy;
+        return found;
+    }
+
+    std::size_t scanned = start;
+    while (true) {
+        auto newline = scanned < end ? static_cast<const char*>(std::memchr(buffer.data() + scanned, '\n', end - scanned)) : nullptr;
+        if (newline != nullptr) {
+            std::size_t length = newline - (buffer.data() + start);
+            line = std::string_view(buffer.data() + start, length);
+            start += length + 1;
+            return true;
+        }
+
+        scanned = end - start; // Offset of the unscanned part once fill() moves the data
+        if (!fill()) {
+            break;
+        }
+        scanned += start;
+    }
+
+    // Last line without a trailing newline
+    line = std::string_view(buffer.data() + start, end - start);
+    bool found = start != end;
+    start = end;
+    return found;
+}
+
+Input& ProcessInput() {
+    static Input in(0, !isatty(0));
+    return in;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Line reader behind SCAN. When stdin is a file or a pipe it is read in large
+// blocks and lines are handed out as views into the block, so a long input
+// costs a handful of reads instead of one stream extraction per value.
+//
+// A terminal, or a REPL that reads its own lines from std::cin, has to share
+// stdin with std::cin and must not read ahead. In that mode lines come from
+// std::getline one at a time.
+class Input {
+public:
+    Input(int fd, bool buffered);
+
+    Input(const Input&) = delete;
+    Input& operator=(const Input&) = delete;
+
+    void SetBuffered(bool buffered) { this->buffered = buffered; }
+
+    // Drops whatever was read ahead and forgets the end of the input, for when
+    // the file descriptor has been pointed at the start of new input
+    void Reset();
+
+    // Next line without its '\n', valid until the next call. At the end of the
+    // input the line is empty and false is returned.
+    bool ReadLine(std::string_view& line);
+
+private:
+    static constexpr std::size_t BlockSize = 64 * 1024;
+
+    int fd;
+    bool buffered;
+    bool eof = false;
+    std::vector<char> buffer;
+    std::size_t start = 0; // Unread data is buffer[start, end)
+    std::size_t end = 0;
+    std::string lineCopy;  // Backing for lines read with std::getline
+
+    bool fill();
+};
+
+// The process's stdin, buffered unless it is a terminal
+Input& ProcessInput();
+
+// Where SCAN reads: the current Runtime's input, which is ProcessInput()
+// unless the host gave the program another
+Input& StandardInput();
@@ -3,6 +3,8 @@
 class Environment;
 
 #include "AST.h"
+#include "Code.h"
+#include "Gc.h"
 
 #include <iostream>
 #include <vector>
@@ -11,6 +13,10 @@ class Environment;
 #include <memory>
 #include <functional>
 #include <unordered_map>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <type_traits>
 
 using ObjectType = std::string;
 
@@ -25,18 +31,11 @@ enum class ObjectType_ {
     STRING_OBJ,
     CHAR_OBJ,
     BUILTIN,
+    COMPILED_FUNCTION_OBJ,
+    CLOSURE_OBJ,
     // Add other types as needed
 };
 
-class Object {
-public:
-    virtual ~Object() = default; 
-
-    virtual ObjectType Type() const = 0; 
-    virtual std::string Inspect() const = 0; 
-    //virtual std::shared_ptr<Object> clone() const = 0;
-};
-
 inline std::string ObjectTypeToString(ObjectType_ type) {
     switch (type) {
         case ObjectType_::INTEGER_OBJ: return "INTEGER";
@@ -48,102 +47,213 @@ inline std::string ObjectTypeToString(ObjectType_ type) {
         case ObjectType_::FUNCTION_OBJ: return "FUNCTION";
         case ObjectType_::STRING_OBJ: return "STRING";
         case ObjectType_::CHAR_OBJ: return "CHAR";
+        case ObjectType_::COMPILED_FUNCTION_OBJ: return "COMPILED_FUNCTION";
+        case ObjectType_::CLOSURE_OBJ: return "FUNCTION"; // To the language a closure is just a function
             // Add cases for other types
         default: return "UNKNOWN";
     }
 }
 
-class IntegerObject : public Object {
+class Object : public Collectable {
 public:
-    int Value;
-
-    IntegerObject(int value) : Value(value) {}
+    // Fixed by each subclass, the evaluator switches on it instead of comparing Type() strings
+    const ObjectType_ Tag;
 
-    ObjectType Type() const override {
-        return ObjectTypeToString(ObjectType_::INTEGER_OBJ);
-    }
+    // Only objects that can end up referencing themselves need tracking
+    explicit Object(ObjectType_ tag, bool tracked = false) : Collectable(tracked), Tag(tag) {}
+    virtual ~Object() = default; 
 
-    std::string Inspect() const override {
-        return std::to_string(Value);
-    }
+    // Type name for messages
+    ObjectType Type() const { return ObjectTypeToString(Tag); }
+    virtual std::string Inspect() const = 0; 
+    //virtual std::shared_ptr<Object> clone() const = 0;
+};
 
-    //std::shared_ptr<Object> clone() const override {
-    //    return std::make_unique<IntegerObject>(Value);
-    //}
+// Value is what the evaluator, the VM, environments and builtins pass around.
+// Scalars (INT, FLOAT, BOOL, CHAR) and NULL are stored inline, so arithmetic
+// and comparisons never touch the heap. Only strings, functions and the other
+// Object subclasses are allocated, and the Value holds a reference to them.
+// An Empty value stands for "no value", what used to be a null pointer.
+enum class ValueKind : std::uint8_t {
+    Empty,
+    Null,
+    Integer,
+    Float,
+    Boolean,
+    Char,
+    Object,
 };
 
-class FloatObject : public Object {
+class Value {
 public:
-    double Value;
+    Value() noexcept {}
+    Value(std::nullptr_t) noexcept {}
+
+    template <typename T, typename = std::enable_if_t<std::is_base_of_v<Object, T>>>
+    Value(Ref<T> obj) noexcept {
+        if (obj) {
+            new (&object) Ref<Object>(std::move(obj));
+            kind = ValueKind::Object;
+        }
+    }
 
-    FloatObject(double value) : Value(value) {}
+    static Value Null() noexcept { Value v; v.kind = ValueKind::Null; return v; }
+    static Value Integer(int value) noexcept { Value v; v.kind = ValueKind::Integer; v.integer = value; return v; }
+    static Value Float(double value) noexcept { Value v; v.kind = ValueKind::Float; v.floating = value; return v; }
+    static Value Boolean(bool value) noexcept { Value v; v.kind = ValueKind::Boolean; v.boolean = value; return v; }
+    static Value Char(char value) noexcept { Value v; v.kind = ValueKind::Char; v.character = value; return v; }
 
-    ObjectType Type() const override {
-        return ObjectTypeToString(ObjectType_::FLOAT_OBJ);
-    }
+    Value(const Value& other) noexcept { copyFrom(other); }
+    Value(Value&& other) noexcept { moveFrom(other); }
 
-    std::string Inspect() const override {
-        return std::to_string(Value);
+    Value& operator=(const Value& other) noexcept {
+        if (this != &other) {
+            reset();
+            copyFrom(other);
+        }
+        return *this;
     }
 
-    // std::shared_ptr<Object> clone() const override {
-    //     return std::make_shared<FloatObject>(Value);
-    // }
-};
+    Value& operator=(Value&& other) noexcept {
+        if (this != &other) {
+            reset();
+            moveFrom(other);
+        }
+        return *this;
+    }
 
+    ~Value() { reset(); }
+
+    ValueKind Kind() const { return kind; }
+    explicit operator bool() const { return kind != ValueKind::Empty; }
+
+    bool IsNull() const { return kind == ValueKind::Null; }
+    bool IsInteger() const { return kind == ValueKind::Integer; }
+    bool IsFloat() const { return kind == ValueKind::Float; }
+    bool IsBoolean() const { return kind == ValueKind::Boolean; }
+    bool IsChar() const { return kind == ValueKind::Char; }
+    bool IsObject() const { return kind == ValueKind::Object; }
+
+    // Only NULL and FALSE are falsy. Decided from the tag alone, so IF, WHILE
+    // and the VM's conditional jump never look at a heap object.
+    bool IsTruthy() const { return kind == ValueKind::Boolean ? boolean : kind != ValueKind::Null; }
+
+    // Unchecked, test Kind() first
+    int AsInteger() const { return integer; }
+    double AsFloat() const { return floating; }
+    bool AsBoolean() const { return boolean; }
+    char AsChar() const { return character; }
+    const Ref<Object>& AsObject() const { return object; }
+
+    // The heap object as a T, or nullptr for scalars and other object types
+    template <typename T>
+    T* As() const {
+        return Is(T::TypeTag) ? static_cast<T*>(object.get()) : nullptr;
+    }
 
-class BooleanObject : public Object {
-public:
-    bool Value;
+    template <typename T>
+    Ref<T> AsRef() const {
+        return Is(T::TypeTag) ? StaticRefCast<T>(object) : nullptr;
+    }
 
-    BooleanObject(bool value) : Value(value) {}
+    // Type of the value, scalar or heap object. Empty reports NULL_OBJ.
+    ObjectType_ Tag() const;
+    bool Is(ObjectType_ tag) const { return Tag() == tag; }
+
+    ObjectType Type() const;
+    std::string Inspect() const;
+
+private:
+    ValueKind kind = ValueKind::Empty;
+    union {
+        std::uint64_t bits = 0; // Every scalar fits, copied as a whole so no member is read inactive
+        int integer;
+        double floating;
+        bool boolean;
+        char character;
+        Ref<Object> object;
+    };
+
+    void reset() noexcept {
+        if (kind == ValueKind::Object) {
+            object.~Ref();
+        }
+        kind = ValueKind::Empty;
+    }
 
-    ObjectType Type() const override {
-        return ObjectTypeToString(ObjectType_::BOOLEAN_OBJ);
+    void copyFrom(const Value& other) noexcept {
+        if (other.kind == ValueKind::Object) {
+            new (&object) Ref<Object>(other.object);
+        }
+        else {
+            copyScalar(other);
+        }
+        kind = other.kind;
     }
 
-    std::string Inspect() const override {
-        return std::to_string(Value);
+    void moveFrom(Value& other) noexcept {
+        if (other.kind == ValueKind::Object) {
+            new (&object) Ref<Object>(std::move(other.object));
+            other.object.~Ref();
+        }
+        else {
+            copyScalar(other);
+        }
+        kind = other.kind;
+        other.kind = ValueKind::Empty;
     }
 
-    //std::shared_ptr<Object> clone() const override {
-    //    return std::make_unique<BooleanObject>(Value);
-    //}
+    void copyScalar(const Value& other) noexcept {
+        std::memcpy(&bits, &other.bits, sizeof(bits));
+    }
 };
 
-class NullObject : public Object {
-
-public:
-    NullObject() {}
+static_assert(sizeof(std::uint64_t) >= sizeof(double), "Value::bits has to cover every scalar");
 
-    ObjectType Type() const override {
-        return ObjectTypeToString(ObjectType_::NULL_OBJ);
+inline ObjectType_ Value::Tag() const {
+    switch (kind) {
+        case ValueKind::Integer: return ObjectType_::INTEGER_OBJ;
+        case ValueKind::Float: return ObjectType_::FLOAT_OBJ;
+        case ValueKind::Boolean: return ObjectType_::BOOLEAN_OBJ;
+        case ValueKind::Char: return ObjectType_::CHAR_OBJ;
+        case ValueKind::Object: return object->Tag;
+        default: return ObjectType_::NULL_OBJ;
     }
+}
 
-    std::string Inspect() const override {
-        return "NULL";
+inline ObjectType Value::Type() const {
+    if (kind == ValueKind::Empty) {
+        return "UNKNOWN";
     }
+    return ObjectTypeToString(Tag());
+}
 
-    //std::shared_ptr<Object> clone() const override {
-    //    return std::make_unique<NullObject>();
-    //}
-};
+inline std::string Value::Inspect() const {
+    switch (kind) {
+        case ValueKind::Null: return "NULL";
+        case ValueKind::Integer: return std::to_string(integer);
+        case ValueKind::Float: return std::to_string(floating);
+        case ValueKind::Boolean: return std::to_string(boolean);
+        case ValueKind::Char: return std::string(1, character);
+        case ValueKind::Object: return object->Inspect();
+        default: return "";
+    }
+}
 
 class ReturnValue : public Object {
 public:
-    std::shared_ptr<Object> Value;
+    static constexpr ObjectType_ TypeTag = ObjectType_::RETURN_VALUE_OBJ;
 
-    explicit ReturnValue(std::shared_ptr<Object> value) : Value(std::move(value)) {}
+    ::Value Value;
+
+    explicit ReturnValue(::Value value) : Object(TypeTag), Value(std::move(value)) {}
 
-    ObjectType Type() const override {
-        return ObjectTypeToString(ObjectType_::RETURN_VALUE_OBJ);
-    }
 
     std::string Inspect() const override {
-        return Value->Inspect();
+        return Value.Inspect();
     }
 
-    std::shared_ptr<Object> TakeValue() {
+    ::Value TakeValue() {
         return std::move(Value);
     }
 
@@ -154,13 +264,13 @@ public:
 
 class ErrorObject : public Object {
 public:
+    static constexpr ObjectType_ TypeTag = ObjectType_::ERROR_OBJ;
+
     std::string Message;
+    uint32_t Line = 0; // Of the statement that raised it, set as the error leaves it
 
-    explicit ErrorObject(std::string message) : Message(std::move(message)) {}
+    explicit ErrorObject(std::string message) : Object(TypeTag), Message(std::move(message)) {}
 
-    ObjectType Type() const override {
-        return ObjectTypeToString(ObjectType_::ERROR_OBJ);
-    }
 
     std::string Inspect() const override {
         return "CODE ERROR - " + Message;
@@ -173,19 +283,24 @@ public:
 
 class Function : public Object {
 public:
+    static constexpr ObjectType_ TypeTag = ObjectType_::FUNCTION_OBJ;
+
     Token ReturnType;
+    SourcePtr Src; // Outlives the Program the body was taken from (REPL), declared first so it goes last
     std::unique_ptr<Expression> CallName;
     std::vector<std::unique_ptr<TypedDeclStatement>> Parameters;
     std::unique_ptr<BlockStatement> Body;
-    std::shared_ptr<Environment> Env; 
+    Ref<Environment> Env; 
+    int NumSlots = 0; // Size of the frame a call needs
 
-    // Constructor with rvalue references for move semantics
-    Function(const Token& returnType, std::unique_ptr<Expression> callName, std::vector<std::unique_ptr<TypedDeclStatement>> params, std::unique_ptr<BlockStatement> body, std::shared_ptr<Environment> env)
-        : ReturnType(returnType), CallName(std::move(callName)), Parameters(std::move(params)), Body(std::move(body)), Env(std::move(env)) {}
+    // Defined in Environment.cpp, holding a Ref needs the complete Environment
+    Function(const Token& returnType, std::unique_ptr<Expression> callName, std::vector<std::unique_ptr<TypedDeclStatement>> params, std::unique_ptr<BlockStatement> body, Ref<Environment> env);
+    ~Function() override;
+
+    // Env usually holds this function in turn
+    void Trace(GcVisitor& visitor) const override;
+    void ClearRefs() override;
 
-    ObjectType Type() const override {
-        return ObjectTypeToString(ObjectType_::FUNCTION_OBJ);
-    }
 
     std::string Inspect() const override {
         std::ostringstream out;
@@ -218,48 +333,119 @@ public:
 
 class String : public Object {
 public:
+    static constexpr ObjectType_ TypeTag = ObjectType_::STRING_OBJ;
+
     std::string Value;
 
-    String(std::string value) : Value(value) {}
+    String(std::string value) : Object(TypeTag), Value(std::move(value)) {}
 
-    ObjectType Type() const override {
-        return ObjectTypeToString(ObjectType_::STRING_OBJ);
-    }
 
     std::string Inspect() const override {
         return Value;
     }
 };
 
-class Char : public Object {
+// The environment is only lent to the call and is null when the VM calls
+using BuiltinFunction = std::function<Value(const std::vector<Value>&, Environment* env)>;
+
+class Builtin : public Object {
 public:
-    char Value;
+    static constexpr ObjectType_ TypeTag = ObjectType_::BUILTIN;
+
+    BuiltinFunction Fn;
+
+    // Constructor accepting a BuiltinFunction
+    Builtin(BuiltinFunction fn) : Object(TypeTag), Fn(std::move(fn)) {}
 
-    Char(char value) : Value(value) {}
 
-    ObjectType Type() const override {
-        return ObjectTypeToString(ObjectType_::CHAR_OBJ);
+    std::string Inspect() const override {
+        return "builtin function";
     }
+};
+
+// Bytecode engine objects
+
+// Where OpClosure finds a captured variable in the frame that creates the closure
+struct Capture {
+    enum class Kind : uint8_t { Local, Free, CurrentClosure };
+
+    Kind From;
+    int Index;
+    std::string Name;
+};
+
+class CompiledFunction : public Object {
+public:
+    static constexpr ObjectType_ TypeTag = ObjectType_::COMPILED_FUNCTION_OBJ;
+
+    std::string Name;
+    Instructions Code;
+    int NumLocals = 0;
+    int NumParameters = 0;
+    int MaxStack = 0; // Deepest the operand stack of a call gets, checked once when the call is made
+    std::vector<std::string> LocalNames; // For error messages
+    std::vector<Capture> Captures;
+
+    CompiledFunction(std::string name, Instructions code, int numLocals, int numParameters)
+        : Object(TypeTag), Name(std::move(name)), Code(std::move(code)), NumLocals(numLocals), NumParameters(numParameters) {}
+
 
     std::string Inspect() const override {
-        return std::string(1, Value);
+        return "CompiledFunction[" + Name + "]";
     }
 };
 
-using BuiltinFunction = std::function<std::shared_ptr<Object>(const std::vector<std::shared_ptr<Object>>&, std::shared_ptr<Environment> env)>;
+// A variable slot in the VM: the value plus the type it was declared with
+struct Binding {
+    TokenType Type = NONE;
+    ::Value Value;
+};
 
-class Builtin : public Object {
+// A VM variable that a closure captured. It moves out of its frame into the
+// cell, and the frame and every closure that captured it share the cell from
+// then on, the way FUNCTIONs share the environment they were declared in: a
+// later declaration in the frame is seen by the closures as well.
+class Cell : public Collectable {
 public:
-    BuiltinFunction Fn;
+    Binding Slot;
 
-    // Constructor accepting a BuiltinFunction
-    Builtin(BuiltinFunction fn) : Fn(std::move(fn)) {}
+    explicit Cell(Binding slot) : Collectable(true), Slot(std::move(slot)) {}
+
+    void Trace(GcVisitor& visitor) const override {
+        if (Slot.Value.IsObject()) {
+            visitor.Visit(Slot.Value.AsObject().get());
+        }
+    }
 
-    ObjectType Type() const override {
-        return ObjectTypeToString(ObjectType_::BUILTIN);
+    void ClearRefs() override {
+        Slot = Binding{};
     }
+};
+
+class Closure : public Object {
+public:
+    static constexpr ObjectType_ TypeTag = ObjectType_::CLOSURE_OBJ;
+
+    Ref<CompiledFunction> Fn;
+    std::vector<Ref<Cell>> Free; // Captured by reference, see Cell
+
+    // Tracked, closures that capture each other close a loop through their cells
+    Closure(Ref<CompiledFunction> fn, std::vector<Ref<Cell>> free)
+        : Object(TypeTag, true), Fn(std::move(fn)), Free(std::move(free)) {}
+
+    void Trace(GcVisitor& visitor) const override {
+        for (const auto& cell : Free) {
+            visitor.Visit(cell.get());
+        }
+    }
+
+    void ClearRefs() override {
+        Free.clear();
+    }
+
+    // To the language a closure is just a function
 
     std::string Inspect() const override {
-        return "builtin function";
+        return "FUNCTION " + Fn->Name;
     }
-};
\ No newline at end of file
+};
@@ -0,0 +1,85 @@
+#include "Output.h"
+
+#include <charconv>
+
+#ifdef _WIN32
+#include <io.h>
+#define isatty _isatty
+#define fileno _fileno
+#else
+#include <unistd.h>
+#endif
+
+Output::Output(std::FILE* sink, FlushPolicy policy) : sink(sink), policy(policy) {
+    buffer.reserve(BlockSize);
+}
+
+Output::~Output() {
+    Flush();
+}
+
+Output& Output::Write(std::string_view text) {
+    buffer.insert(buffer.end(), text.begin(), text.end());
+    return *this;
+}
+
+Output& Output::Write(char c) {
+    buffer.push_back(c);
+    return *this;
+}
+
+Output& Output::Write(int64_t number) {
+    char digits[24];
+    auto result = std::to_chars(digits, digits + sizeof(digits), number);
+    buffer.insert(buffer.end(), digits, result.ptr);
+    return *this;
+}
+
+// Same text as `std::cout << number` with the default stream settings (%g)
+Output& Output::Write(double number) {
+    char digits[32];
+    auto result = std::to_chars(digits, digits + sizeof(digits), number, std::chars_format::general, 6);
+    buffer.insert(buffer.end(), digits, result.ptr);
+    return *this;
+}
+
+void Output::SetSink(std::FILE* sink) {
+    Flush();
+    this->sink = sink;
+}
+
+void Output::EndLine() {
+    buffer.push_back('\n');
+    if (policy == FlushPolicy::Line || (policy == FlushPolicy::Block && buffer.size() >= BlockSize)) {
+        Flush();
+    }
+}
+
+void Output::Flush() {
+    if (!buffer.empty()) {
+        std::fwrite(buffer.data(), 1, buffer.size(), sink);
+        buffer.clear();
+    }
+    std::fflush(sink);
+}
+
+bool Output::ParsePolicy(std::string_view name, FlushPolicy& policy) {
+    if (name == "line") {
+        policy = FlushPolicy::Line;
+    }
+    else if (name == "block") {
+        policy = FlushPolicy::Block;
+    }
+    else if (name == "none") {
+        policy = FlushPolicy::None;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+Output& ProcessOutput() {
+    static Output out(stdout, isatty(fileno(stdout)) ? FlushPolicy::Line : FlushPolicy::Block);
+    return out;
+}
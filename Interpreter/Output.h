@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string_view>
+#include <vector>
+
+// When buffered program output is handed to the operating system
+enum class FlushPolicy {
+    Line,  // After every line, for watching a program run in a terminal
+    Block, // Whenever the buffer fills up
+    None,  // Only at exit, before SCAN waits for input, or on request
+};
+
+// Buffered standard output of the program being run. DISPLAY and the runtime
+// errors of both engines go through here so they come out in order, and
+// numbers are formatted straight into the buffer.
+//
+// Writes go to the C stdio stream underneath, the same one std::cout is synced
+// with, so the few messages printed around evaluation stay in place as long as
+// the buffer is flushed before them.
+class Output {
+public:
+    explicit Output(std::FILE* sink, FlushPolicy policy);
+    ~Output();
+
+    Output(const Output&) = delete;
+    Output& operator=(const Output&) = delete;
+
+    void SetPolicy(FlushPolicy policy) { this->policy = policy; }
+
+    // Flushes what is buffered for the current sink and writes to sink from now on
+    void SetSink(std::FILE* sink);
+    FlushPolicy Policy() const { return policy; }
+
+    Output& Write(std::string_view text);
+    Output& Write(char c);
+    Output& Write(int64_t number);
+    Output& Write(int number) { return Write(static_cast<int64_t>(number)); }
+    Output& Write(double number);
+
+    // Ends the current line and flushes if the policy asks for it
+    void EndLine();
+    void Flush();
+
+    // Parses "line", "block" or "none". Returns false for anything else.
+    static bool ParsePolicy(std::string_view name, FlushPolicy& policy);
+
+private:
+    static constexpr std::size_t BlockSize = 64 * 1024;
+
+    std::FILE* sink;
+    FlushPolicy policy;
+    std::vector<char> buffer;
+};
+
+// The process's stdout. Line buffered on a terminal and block buffered
+// otherwise until main applies --flush, flushed when the process exits.
+Output& ProcessOutput();
+
+// Where DISPLAY writes: the current Runtime's output, which is ProcessOutput()
+// unless the host gave the program another
+Output& StandardOutput();
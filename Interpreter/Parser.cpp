@@ -1,11 +1,12 @@
 #include "Parser.h"
+#include "Object.h"
 #include "Tracer.h"
+#include <charconv>
+#include <climits>
 
 void Parser::nextToken() {
     curToken = peekToken;
-    if (curToken.Literal == NEWLINE) incrementLine();
-
-    peekToken = lexer->NextToken();
+    peekToken = tokens.At(nextIndex++);
 }   
 
 bool Parser::isTypedDeclStatementStart() const {
@@ -22,6 +23,7 @@ template<class... Ts> overloaded(Ts...) -> overloaded<Ts...>;
 
 std::unique_ptr<Program> Parser::ParseProgram() {
     auto program = std::make_unique<Program>();
+    program->Src = source;
 
     while (curToken.Type != EOF_TOKEN) {
         if (isTypedDeclStatementStart()) { // Check if the current token starts a typed declaration
@@ -221,7 +223,7 @@ std::vector<DeclStatementWrapper> Parser::parseTypedDeclStatements() {
     } while (true);
 
     // Ensure end of declaration with NEWLINE or EOF_TOKEN
-    if (!expectPeek(NEWLINE, EOF_TOKEN, "Expected end of statement after declaration.")) {
+    if (!expectPeek(NEWLINE, EOF_TOKEN)) {
         return {};
     }
 
@@ -271,7 +273,7 @@ std::unique_ptr<ExpressionStatement> Parser::parseExpressionStatement() {
         nextToken();
     }
 
-    currentParsedType = { "", "" };
+    currentParsedType = { NONE, "" };
 
     return stmt;
 }
@@ -313,27 +315,18 @@ std::vector<std::unique_ptr<TypedDeclStatement>> Parser::parseFunctionParameters
     do {
         nextToken(); // Move to the first parameter or next parameter after ','
 
-        if (isTypedDeclStatementStart()) {
-            auto declWrappers = parseTypedDeclStatements();
-
-            for (auto& wrapper : declWrappers) {
-                std::visit(overloaded{
-                    [&typedDeclStmts](std::unique_ptr<TypedDeclStatement>& stmt) {
-                        typedDeclStmts.push_back(std::move(stmt));
-                    },
-                    [](std::unique_ptr<MultiTypedDeclStatement>& multiStmt) {
-                        // MultiTypedDeclStatement is not expected in function parameters.
-                        // You can log an error or handle it according to your needs.
-                        // For simplicity, ignoring it here but in a real scenario, you should handle this case.
-                        std::cerr << "MultiTypedDeclStatement is not allowed in function parameters." << std::endl;
-                    },
-                    [](auto&&) {
-                        // Handle error or nullptr cases
-                    }
-                }, wrapper.content); // Assuming wrapper is the variant holding either TypedDeclStatement or MultiTypedDeclStatement
-            }
+        // A parameter is a single <TYPE> <IDENT> pair; unlike a declaration
+        // statement it has no initializer and is not terminated by a NEWLINE.
+        if (!isTypedDeclStatementStart()) {
+            errors.push_back("Error: Expected parameter type, got " + std::string(TokenTypeName(curToken.Type)) + " instead.");
+            return {};
         }
+        Token typeToken = curToken;
 
+        if (!customExpectPeek("Expected parameter name.", IDENT)) {
+            return {};
+        }
+        typedDeclStmts.push_back(std::make_unique<TypedDeclStatement>(typeToken, std::make_unique<Identifier>(curToken, curToken.Literal)));
 
         if (!peekTokenIs(COMMA)) {
             break; // Exit if the next token is not a comma
@@ -351,25 +344,23 @@ std::vector<std::unique_ptr<TypedDeclStatement>> Parser::parseFunctionParameters
 std::unique_ptr<Expression> Parser::parseExpression(Precedence precedence) {
     Tracer tracer("parseExpression");
 
-    auto prefixIt = prefixParseFns.find(curToken.Type);
-    if (prefixIt == prefixParseFns.end()) {
+    auto& prefixFn = prefixParseFns[curToken.Type];
+    if (!prefixFn) {
         std::cerr << "Unexpected token: " << curToken.Type << std::endl;
         noPrefixParseFnError(curToken.Type);
         return nullptr;
     }
 
-    auto& prefixFn = prefixIt->second;
     std::unique_ptr<Expression> leftExp = prefixFn();
 
     // TODO: Handle explicitly forcing a new expression to be on a new line,
     // current implementation doesn't handle this
     while (!peekTokenIs(NEWLINE) && precedence < peekPrecedence()) {
-        auto infixIt = infixParseFns.find(peekToken.Type);
-        if (infixIt == infixParseFns.end()) {
+        auto& infixFn = infixParseFns[peekToken.Type];
+        if (!infixFn) {
             return leftExp;
         }
 
-        auto& infixFn = infixIt->second;
         nextToken();
 
         leftExp = infixFn(std::move(leftExp));
@@ -391,14 +382,15 @@ std::unique_ptr<Expression> Parser::parseNumericalLiteral() {
 
     if (peekTokenIs(DOT)) {
         // Handle float
-        std::string floatLiteral = curToken.Literal;
+        std::string floatLiteral(curToken.Literal);
         nextToken(); // Consume the '.'
         if (!expectPeek(NUM)) {
-            std::string msg = "expected number after dot, got " + peekToken.Literal;
+            std::string msg = "expected number after dot, got " + std::string(peekToken.Literal);
             errors.push_back(msg);
             return nullptr;
         }
-        floatLiteral += "." + curToken.Literal;
+        floatLiteral += ".";
+        floatLiteral += curToken.Literal;
         char* end;
         double value = std::strtod(floatLiteral.c_str(), &end);
 
@@ -414,15 +406,21 @@ std::unique_ptr<Expression> Parser::parseNumericalLiteral() {
             return nullptr;
         }
 
-        return std::make_unique<FloatLiteral>(Token(FLOAT, floatLiteral), value);
+        // The joined spelling is not a slice of the source, so it has to be interned
+        return std::make_unique<FloatLiteral>(Token{ FLOAT, source->Intern(floatLiteral), curToken.Line }, value);
     }
     else {
         // Handle integer
-        char* end;
-        long int value = std::strtol(curToken.Literal.c_str(), &end, 10); // Using base 10 for conversion
+        const char* first = curToken.Literal.data();
+        const char* last = first + curToken.Literal.size();
+        long int value = 0;
+        auto [end, ec] = std::from_chars(first, last, value); // Base 10, straight off the source
+        if (ec == std::errc::result_out_of_range) {
+            value = LONG_MAX; // Saturate like strtol did
+        }
 
-        if (*end != '\0') { // Check if the entire string was converted
-            std::string msg = "could not parse " + curToken.Literal + " as integer";
+        if (ec == std::errc::invalid_argument || end != last) { // Check if the entire literal was converted
+            std::string msg = "could not parse " + std::string(curToken.Literal) + " as integer";
             errors.push_back(msg);
             return nullptr;
         }
@@ -434,19 +432,19 @@ std::unique_ptr<Expression> Parser::parseNumericalLiteral() {
 std::unique_ptr<Expression> Parser::parseStringLiteral() {
     Tracer tracer("parseStringLiteral");
 
-    return std::make_unique<StringLiteral>(curToken, curToken.Literal);
+    return std::make_unique<StringLiteral>(curToken, curToken.Literal, MakeRef<String>(std::string(curToken.Literal)));
 }
 
 std::unique_ptr<Expression> Parser::parseCharLiteral() {
     Tracer tracer("parseCharLiteral");
 
     if (curToken.Literal.length() > 1) {
-        std::string errorMessage = "Character literals must contain only one character. Found '" + curToken.Literal + "'";
+        std::string errorMessage = "Character literals must contain only one character. Found '" + std::string(curToken.Literal) + "'";
         errors.push_back(errorMessage);
         return nullptr; 
     }
 
-    char charValue = curToken.Literal[0];
+    char charValue = curToken.Literal.empty() ? '\0' : curToken.Literal[0];
     return std::make_unique<CharLiteral>(curToken, charValue);
 }
 
@@ -466,7 +464,7 @@ std::unique_ptr<Expression> Parser::parseInfixExpression(std::unique_ptr<Express
     Tracer tracer("parseInfixExpression");
 
     Token token = curToken;
-    std::string op = curToken.Literal;
+    std::string_view op = curToken.Literal;
     auto precedence = curPrecedence();
 
     nextToken(); 
@@ -668,6 +666,7 @@ std::unique_ptr<Expression> Parser::parseFunctionLiteral(Token fnToken, std::uni
     Tracer tracer("parseFunctionLiteral");
 
     auto lit = std::make_unique<FunctionLiteral>(fnToken);
+    lit->Src = source;
 
     lit->CallName = std::move(CallName);
 
@@ -857,8 +856,8 @@ bool Parser::customExpectPeek(const std::string& errorMessage, const TokenType&
             peekError(errorMessage);
         }
         else {
-            std::string msg = "Expected next token to be " + std::string(t) +
-                ", got " + std::string(peekToken.Type) + " instead.";
+            std::string msg = "Expected next token to be " + std::string(TokenTypeName(t)) +
+                ", got " + std::string(TokenTypeName(peekToken.Type)) + " instead.";
             peekError(msg);
         }
         return false;
@@ -892,19 +891,11 @@ bool Parser::customExpectPeek(const std::string& errorMessage, TokenTypes... typ
 }
 
 Precedence Parser::peekPrecedence() const {
-    auto it = precedences.find(peekToken.Type);
-    if (it != precedences.end()) {
-        return it->second;
-    }
-    return Precedence::LOWEST;
+    return precedences[peekToken.Type];
 }
 
 Precedence Parser::curPrecedence() const {
-    auto it = precedences.find(curToken.Type);
-    if (it != precedences.end()) {
-        return it->second;
-    }
-    return Precedence::LOWEST;
+    return precedences[curToken.Type];
 }
 
 // Error handling
@@ -914,22 +905,22 @@ std::vector<std::string> Parser::Errors() const {
 }
 
 void Parser::peekError(const TokenType& expected) {
-    //std::string msg = "Error on line " + std::to_string(currentLine) + ": Expected next token to be " +
+    //std::string msg = "Error on line " + std::to_string(peekToken.Line) + ": Expected next token to be " +
     //    std::string(expected) + ", got " + std::string(peekToken.Type) + " instead.";
     std::string msg = "Error: Expected next token to be " +
-        std::string(expected) + ", got " + std::string(peekToken.Type) + " instead.";
+        std::string(TokenTypeName(expected)) + ", got " + std::string(TokenTypeName(peekToken.Type)) + " instead.";
     errors.push_back(msg);
 }
 
 
 void Parser::peekError(const std::string& message) {
-    //errors.push_back("Error on line " + std::to_string(currentLine) + ": " + message);
+    //errors.push_back("Error on line " + std::to_string(peekToken.Line) + ": " + message);
     errors.push_back("Error: " + message);
 }
 
 
 void Parser::noPrefixParseFnError(TokenType t) {
-    std::string msg = "no prefix parse function for " + std::string(t) + " found";
+    std::string msg = "no prefix parse function for " + std::string(TokenTypeName(t)) + " found";
     errors.push_back(msg);
 }
 
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <memory> 
 #include <functional>
 #include <iostream>
@@ -7,6 +8,7 @@
 #include <variant>
 #include "Lexer.h" 
 #include "Token.h" 
+#include "TokenStream.h"
 #include "AST.h"  
 
 enum class Precedence : int {
@@ -28,8 +30,6 @@ enum class ParseState {
     EndCode
 };
 
-static ParseState mainstate = ParseState::BeginCode;
-
 using prefixParseFn = std::function<std::unique_ptr<Expression>()>;
 using infixParseFn = std::function<std::unique_ptr<Expression>(std::unique_ptr<Expression>)>;
 
@@ -44,7 +44,10 @@ public:
 
 class Parser {
 public:
-    Parser(std::unique_ptr<Lexer> lexer) : lexer(std::move(lexer)) {
+    Parser(std::unique_ptr<Lexer> lexer) : Parser(TokenStream(*lexer)) {}
+
+    // Parses tokens lexed beforehand
+    explicit Parser(TokenStream tokens) : source(tokens.GetSource()), tokens(std::move(tokens)) {
         // Call nextToken twice to initialize currToken and peekToken
         nextToken();
         nextToken();
@@ -52,11 +55,15 @@ public:
         setupPrefixParseFns();
         setupInfixParseFns();
     }
-    
+
+private:
+    // Declared first so it goes last: tokens held below point into it
+    SourcePtr source;
+
+public:
     bool enforcedStructure = true;
-    int currentLine = 1;
 
-    Token currentParsedType = {"", ""};
+    Token currentParsedType = {NONE, ""};
     std::unique_ptr<Expression> currentParsedCallName = nullptr;
 
     bool isTypedDeclStatementStart() const;
@@ -111,48 +118,46 @@ public:
     // Error handling
 
     std::vector<std::string> Errors() const;
+
+    // Everything the parser reads, for tools that want the tokens as well
+    const TokenStream& Tokens() const { return tokens; }
     void peekError(const TokenType& expected);
     void peekError(const std::string& message);
     void noPrefixParseFnError(TokenType t);
 
     // Token <--> Parser functions - mapping
 
-    std::unordered_map<TokenType, prefixParseFn> prefixParseFns;
-    std::unordered_map<TokenType, infixParseFn> infixParseFns;
+    // Indexed by token kind, an empty entry means no parse function
+    std::array<prefixParseFn, TOKEN_TYPE_COUNT> prefixParseFns;
+    std::array<infixParseFn, TOKEN_TYPE_COUNT> infixParseFns;
 
     void registerPrefix(TokenType type, prefixParseFn fn);
     void registerInfix(TokenType type, infixParseFn fn);
 
-    std::unordered_map<TokenType, Precedence> precedences = {
-        {AMPERSAND, Precedence::CONCATENATE},
-        {EQ, Precedence::EQUALS},
-        {NEQ, Precedence::EQUALS},
-        {LT, Precedence::LESSGREATER},
-        {GT, Precedence::LESSGREATER}, 
-        {PLUS, Precedence::SUM},
-        {MINUS, Precedence::SUM},
-        {SLASH, Precedence::PRODUCT},
-        {ASTERISK, Precedence::PRODUCT},
-        {COLON, Precedence::CALL},
-        {ASSIGN, Precedence::CALL},
-    };
+    // Indexed by token kind, tokens that are not operators bind with LOWEST
+    static constexpr std::array<Precedence, TOKEN_TYPE_COUNT> precedences = [] {
+        std::array<Precedence, TOKEN_TYPE_COUNT> table{};
+        table.fill(Precedence::LOWEST);
+        table[AMPERSAND] = Precedence::CONCATENATE;
+        table[EQ] = Precedence::EQUALS;
+        table[NEQ] = Precedence::EQUALS;
+        table[LT] = Precedence::LESSGREATER;
+        table[GT] = Precedence::LESSGREATER;
+        table[PLUS] = Precedence::SUM;
+        table[MINUS] = Precedence::SUM;
+        table[SLASH] = Precedence::PRODUCT;
+        table[ASTERISK] = Precedence::PRODUCT;
+        table[COLON] = Precedence::CALL;
+        table[ASSIGN] = Precedence::CALL;
+        return table;
+    }();
 private:
-    std::unique_ptr<Lexer> lexer; 
+    TokenStream tokens;
+    std::size_t nextIndex = 0; // Of the token after peekToken
     std::vector<std::string> errors;
     Token curToken;
     Token peekToken;
 
-    size_t commentIndex = 0; 
-
-    void incrementLine() {
-        currentLine++;
-        // Continue to skip comment lines without modifying the vector
-        while (commentIndex < Lexer::commentLinePositions.size() && currentLine == Lexer::commentLinePositions[commentIndex]) {
-            currentLine++;
-            commentIndex++;  // Move to the next comment line index
-        }
-    }
-
     void nextToken();
 
     // Setup the prefix parse functions
@@ -277,7 +282,7 @@ private:
 
 static std::unique_ptr<Expression> extractExpression(const std::unique_ptr<Statement>& stmt) {
     // Utility function to extract an Expression from a Statement if possible.
-    const auto exprStmt = dynamic_cast<ExpressionStatement*>(stmt.get());
+    const auto exprStmt = stmt ? stmt->As<ExpressionStatement>() : nullptr;
     if (exprStmt && exprStmt->Expression_) { // Ensure exprStmt and its Expression_ are not nullptr
         auto clonedExpr = exprStmt->Expression_->clone();
         if (clonedExpr) { // Ensure clonedExpr is not nullptr
@@ -288,21 +293,21 @@ static std::unique_ptr<Expression> extractExpression(const std::unique_ptr<State
 }
 
 static bool isBeginCodeStatement(const std::unique_ptr<Statement>& stmt) {
-    auto markerStmt = dynamic_cast<MarkerStatement*>(stmt.get());
-    return markerStmt && markerStmt->token.Literal + " " + markerStmt->codeToken.Literal == "BEGIN CODE";
+    auto markerStmt = stmt ? stmt->As<MarkerStatement>() : nullptr;
+    return markerStmt && markerStmt->token.Literal == "BEGIN" && markerStmt->codeToken.Literal == "CODE";
 }
 
 static bool isEndCodeStatement(const std::unique_ptr<Statement>& stmt) {
-    auto markerStmt = dynamic_cast<MarkerStatement*>(stmt.get());
-    return markerStmt && markerStmt->token.Literal + " " + markerStmt->codeToken.Literal == "END CODE";
+    auto markerStmt = stmt ? stmt->As<MarkerStatement>() : nullptr;
+    return markerStmt && markerStmt->token.Literal == "END" && markerStmt->codeToken.Literal == "CODE";
 }
 
 static bool isTransitionToVariableDeclarations(const std::unique_ptr<Statement>& stmt) {
-    if (auto typedDeclStmt = dynamic_cast<TypedDeclStatement*>(stmt.get())) {
+    if (stmt && stmt->As<TypedDeclStatement>()) {
         //std::cout << "Transition to var decl state" << std::endl;
         return true;
     }
-    else if (auto multiTypedDeclStmt = dynamic_cast<MultiTypedDeclStatement*>(stmt.get())) {
+    else if (stmt && stmt->As<MultiTypedDeclStatement>()) {
         //std::cout << "Transition to var decl state" << std::endl;
         return true;
     }
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+#include <utility>
+
+// Base of everything the interpreter hands around by reference: the objects
+// behind a Value and the environments frames are chained through. The count
+// lives in the object itself and is a plain, non-atomic integer, which spares
+// every copy the atomic update and separate control block of std::shared_ptr.
+//
+// In exchange an object must never be reachable from two Runtimes (see
+// Runtime.h), as those may run on different threads. That includes the String
+// a StringLiteral builds at parse time (StringLiteral::Constant), which every
+// evaluation and compilation of the Program takes a reference to.
+class RefCounted {
+public:
+    RefCounted() = default;
+    RefCounted(const RefCounted&) {}
+    RefCounted& operator=(const RefCounted&) { return *this; }
+
+protected:
+    ~RefCounted() = default;
+
+private:
+    template <typename T>
+    friend class Ref;
+    friend class Collector;
+
+    mutable uint32_t refs = 0;
+};
+
+// Owning pointer to a RefCounted object, used like a std::shared_ptr. The last
+// Ref to go deletes the object through T, so a base such as Object needs a
+// virtual destructor.
+//
+// Copying a Ref is what costs, code that only looks at an object should take
+// a const Ref& or a plain pointer or reference to it.
+template <typename T>
+class Ref {
+public:
+    Ref() noexcept = default;
+    Ref(std::nullptr_t) noexcept {}
+
+    // Takes a freshly created object, see MakeRef
+    explicit Ref(T* object) noexcept : ptr(object) { retain(); }
+
+    Ref(const Ref& other) noexcept : ptr(other.ptr) { retain(); }
+    Ref(Ref&& other) noexcept : ptr(std::exchange(other.ptr, nullptr)) {}
+
+    template <typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+    Ref(const Ref<U>& other) noexcept : ptr(other.ptr) { retain(); }
+
+    template <typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+    Ref(Ref<U>&& other) noexcept : ptr(std::exchange(other.ptr, nullptr)) {}
+
+    ~Ref() { release(); }
+
+    Ref& operator=(const Ref& other) noexcept {
+        Ref(other).swap(*this);
+        return *this;
+    }
+
+    Ref& operator=(Ref&& other) noexcept {
+        Ref(std::move(other)).swap(*this);
+        return *this;
+    }
+
+    void swap(Ref& other) noexcept { std::swap(ptr, other.ptr); }
+
+    void reset() noexcept {
+        release();
+        ptr = nullptr;
+    }
+
+    T* get() const noexcept { return ptr; }
+    T& operator*() const noexcept { return *ptr; }
+    T* operator->() const noexcept { return ptr; }
+    explicit operator bool() const noexcept { return ptr != nullptr; }
+
+    // Number of Refs to the object, for code that may reuse an unshared one
+    uint32_t use_count() const noexcept { return ptr ? ptr->refs : 0; }
+
+private:
+    template <typename U>
+    friend class Ref;
+
+    T* ptr = nullptr;
+
+    void retain() const noexcept {
+        if (ptr) {
+            ++ptr->refs;
+        }
+    }
+
+    void release() noexcept {
+        if (ptr && --ptr->refs == 0) {
+            delete ptr;
+        }
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const Ref<T>& left, const Ref<U>& right) noexcept {
+    return left.get() == right.get();
+}
+
+template <typename T>
+bool operator==(const Ref<T>& left, std::nullptr_t) noexcept {
+    return left.get() == nullptr;
+}
+
+template <typename T, typename... Args>
+Ref<T> MakeRef(Args&&... args) {
+    return Ref<T>(new T(std::forward<Args>(args)...));
+}
+
+// The caller has checked the object really is a T
+template <typename T, typename U>
+Ref<T> StaticRefCast(const Ref<U>& ref) noexcept {
+    return Ref<T>(static_cast<T*>(ref.get()));
+}
+
+template <typename T>
+struct std::hash<Ref<T>> {
+    std::size_t operator()(const Ref<T>& ref) const noexcept {
+        return std::hash<T*>()(ref.get());
+    }
+};
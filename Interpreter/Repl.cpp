@@ -8,7 +8,8 @@ static void printParserErrors(std::ostream& out, const std::vector<std::string>&
 
 void Repl::Start(std::istream& in, std::ostream& out) {
     const std::string PROMPT = ">> ";
-    auto env = std::make_shared<Environment>();
+    auto env = MakeRef<Environment>();
+    StandardInput().SetBuffered(false); // SCAN shares stdin with the lines read here
 
     while (true) {
         out << PROMPT;
@@ -26,9 +27,11 @@ void Repl::Start(std::istream& in, std::ostream& out) {
             continue;
         }
 
+        Resolver(*env).Resolve(program.get());
         auto evaluated = Eval(program.get(), env);
-        if (evaluated != nullptr) {
-            out << evaluated->Inspect() << std::endl;
+        StandardOutput().Flush(); // DISPLAY output goes before the result and the next prompt
+        if (evaluated) {
+            out << evaluated.Inspect() << std::endl;
         }
     }
 }
\ No newline at end of file
@@ -0,0 +1,250 @@
+#include "Resolver.h"
+
+void Resolver::Resolve(Program* program) {
+    for (const auto& stmt : program->Statements) {
+        declareStatement(stmt.get());
+    }
+    for (const auto& stmt : program->Statements) {
+        resolveStatement(stmt.get());
+    }
+}
+
+bool Resolver::lookup(Identifier* ident) {
+    int depth = 0;
+    for (auto scope = scopes.rbegin(); scope != scopes.rend(); ++scope, ++depth) {
+        auto it = scope->slots.find(ident->Value);
+        if (it != scope->slots.end()) {
+            ident->Depth = depth;
+            ident->Slot = it->second;
+            return true;
+        }
+    }
+
+    int slot = globals.FindGlobal(std::string(ident->Value));
+    if (slot >= 0) {
+        ident->Depth = depth;
+        ident->Slot = slot;
+        return true;
+    }
+
+    // Left to the name based lookup at runtime
+    ident->Depth = -1;
+    ident->Slot = -1;
+    return false;
+}
+
+void Resolver::define(Identifier* ident) {
+    if (lookup(ident)) {
+        return;
+    }
+
+    if (scopes.empty()) {
+        ident->Depth = 0;
+        ident->Slot = globals.DefineGlobal(std::string(ident->Value));
+        return;
+    }
+
+    auto& slots = scopes.back().slots;
+    ident->Depth = 0;
+    ident->Slot = static_cast<int>(slots.size());
+    slots.emplace(ident->Value, ident->Slot);
+}
+
+void Resolver::declareStatement(Statement* stmt) {
+    if (stmt == nullptr) {
+        return;
+    }
+
+    switch (stmt->Kind) {
+    case NodeKind::TypedDeclStatement: {
+        auto decl = static_cast<TypedDeclStatement*>(stmt);
+        if (decl->Name) {
+            define(decl->Name.get());
+        }
+        break;
+    }
+    case NodeKind::MultiTypedDeclStatement: {
+        auto multi = static_cast<MultiTypedDeclStatement*>(stmt);
+        for (const auto& name : multi->Names) {
+            if (name) {
+                define(name.get());
+            }
+        }
+        break;
+    }
+    case NodeKind::ExpressionStatement: {
+        auto exprStmt = static_cast<ExpressionStatement*>(stmt);
+        if (auto name = exprStmt->name ? exprStmt->name->As<Identifier>() : nullptr) {
+            define(name);
+        }
+        declareExpression(exprStmt->Expression_.get());
+        break;
+    }
+    case NodeKind::BlockStatement: {
+        auto block = static_cast<BlockStatement*>(stmt);
+        for (const auto& s : block->Statements) {
+            declareStatement(s.get());
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+void Resolver::declareExpression(Expression* expr) {
+    if (expr == nullptr) {
+        return;
+    }
+
+    switch (expr->Kind) {
+    case NodeKind::FunctionLiteral: {
+        auto funcLit = static_cast<FunctionLiteral*>(expr);
+        if (auto name = funcLit->CallName ? funcLit->CallName->As<Identifier>() : nullptr) {
+            define(name);
+        }
+        break;
+    }
+    case NodeKind::IfExpression: {
+        auto ifExpr = static_cast<IfExpression*>(expr);
+        // IF blocks don't get a frame of their own
+        for (const auto& branch : ifExpr->Branches) {
+            declareStatement(branch.second.get());
+        }
+        if (ifExpr->Alternative) {
+            declareStatement(ifExpr->Alternative.get());
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+void Resolver::resolveStatement(Statement* stmt) {
+    if (stmt == nullptr) {
+        return;
+    }
+
+    switch (stmt->Kind) {
+    case NodeKind::TypedDeclStatement: {
+        auto decl = static_cast<TypedDeclStatement*>(stmt);
+        if (decl->Value) {
+            resolveExpression(decl->Value.get());
+        }
+        break;
+    }
+    case NodeKind::MultiTypedDeclStatement: {
+        auto multi = static_cast<MultiTypedDeclStatement*>(stmt);
+        for (const auto& value : multi->Values) {
+            if (value) {
+                resolveExpression(value.get());
+            }
+        }
+        break;
+    }
+    case NodeKind::ExpressionStatement: {
+        auto exprStmt = static_cast<ExpressionStatement*>(stmt);
+        if (exprStmt->Expression_) {
+            resolveExpression(exprStmt->Expression_.get());
+        }
+        break;
+    }
+    case NodeKind::ReturnStatement: {
+        auto ret = static_cast<ReturnStatement*>(stmt);
+        if (ret->ReturnValue) {
+            resolveExpression(ret->ReturnValue.get());
+        }
+        break;
+    }
+    case NodeKind::BlockStatement:
+        resolveBlock(static_cast<BlockStatement*>(stmt));
+        break;
+    default:
+        break;
+    }
+}
+
+void Resolver::resolveBlock(BlockStatement* block) {
+    for (const auto& s : block->Statements) {
+        resolveStatement(s.get());
+    }
+}
+
+void Resolver::resolveExpression(Expression* expr) {
+    if (expr == nullptr) {
+        return;
+    }
+
+    switch (expr->Kind) {
+    case NodeKind::Identifier:
+        lookup(static_cast<Identifier*>(expr));
+        break;
+    case NodeKind::PrefixExpression:
+        resolveExpression(static_cast<PrefixExpression*>(expr)->Right.get());
+        break;
+    case NodeKind::InfixExpression: {
+        auto infix = static_cast<InfixExpression*>(expr);
+        resolveExpression(infix->Left.get());
+        resolveExpression(infix->Right.get());
+        break;
+    }
+    case NodeKind::IfExpression: {
+        auto ifExpr = static_cast<IfExpression*>(expr);
+        for (const auto& branch : ifExpr->Branches) {
+            resolveExpression(branch.first.get());
+            resolveBlock(branch.second.get());
+        }
+        if (ifExpr->Alternative) {
+            resolveBlock(ifExpr->Alternative.get());
+        }
+        break;
+    }
+    case NodeKind::WhileExpression: {
+        auto whileExpr = static_cast<WhileExpression*>(expr);
+        // The condition is evaluated inside the iteration's frame as well
+        scopes.emplace_back();
+        declareStatement(whileExpr->Body.get());
+        resolveExpression(whileExpr->Condition.get());
+        resolveBlock(whileExpr->Body.get());
+        whileExpr->NumSlots = static_cast<int>(scopes.back().slots.size());
+        scopes.pop_back();
+        break;
+    }
+    case NodeKind::FunctionLiteral: {
+        auto funcLit = static_cast<FunctionLiteral*>(expr);
+        if (auto name = funcLit->CallName ? funcLit->CallName->As<Identifier>() : nullptr) {
+            define(name);
+        }
+        scopes.emplace_back();
+        for (const auto& param : funcLit->Parameters) {
+            if (param->Name) {
+                define(param->Name.get());
+            }
+        }
+        declareStatement(funcLit->Body.get());
+        resolveBlock(funcLit->Body.get());
+        funcLit->NumSlots = static_cast<int>(scopes.back().slots.size());
+        scopes.pop_back();
+        break;
+    }
+    case NodeKind::CallExpression: {
+        auto call = static_cast<CallExpression*>(expr);
+        resolveExpression(call->Function.get());
+        for (const auto& arg : call->Arguments) {
+            resolveExpression(arg.get());
+        }
+        break;
+    }
+    case NodeKind::AssignExpression: {
+        auto assign = static_cast<AssignExpression*>(expr);
+        for (const auto& name : assign->names) {
+            resolveExpression(name.get());
+        }
+        resolveExpression(assign->value.get());
+        break;
+    }
+    default:
+        break;
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include "AST.h"
+#include "Environment.h"
+
+// Runs over a parsed Program before the tree-walker evaluates it and gives
+// every identifier a (depth, slot) address, mirroring the frames Eval creates:
+// the global frame, one per function call and one per WHILE iteration. IF
+// blocks share the frame they appear in.
+//
+// A scope's slots cover every name declared anywhere in it, so a function body
+// can refer to a global declared further down. Reading a slot before its
+// declaration has run finds it empty, like the name lookup used to. As with
+// Environment::Set, declaring a name that an enclosing scope already has
+// reuses that variable instead of shadowing it.
+class Resolver {
+public:
+    explicit Resolver(Environment& globals) : globals(globals) {}
+
+    void Resolve(Program* program);
+
+private:
+    struct Scope {
+        std::unordered_map<std::string_view, int> slots;
+    };
+
+    Environment& globals;
+    std::vector<Scope> scopes; // Innermost last, the global scope lives in `globals`
+
+    bool lookup(Identifier* ident);
+    void define(Identifier* ident);
+
+    // Pass 1: claim slots for the declarations of the current scope
+    void declareStatement(Statement* stmt);
+    void declareExpression(Expression* expr);
+
+    // Pass 2: address every identifier, opening scopes for functions and loops
+    void resolveStatement(Statement* stmt);
+    void resolveExpression(Expression* expr);
+    void resolveBlock(BlockStatement* block);
+};
@@ -0,0 +1,39 @@
+#include "Runtime.h"
+#include "Evaluator.h"
+
+namespace {
+
+thread_local Runtime* current = nullptr;
+
+}
+
+Runtime::Runtime(Output& output, Input& input)
+    : Builtins(MakeBuiltins()), Scan(Builtins.at("SCAN")), Out(output), In(input) {}
+
+Runtime& CurrentRuntime() {
+    if (current == nullptr) {
+        thread_local Runtime standard(ProcessOutput(), ProcessInput());
+        current = &standard;
+    }
+    return *current;
+}
+
+RuntimeScope::RuntimeScope(Runtime& runtime) : previous(current) {
+    current = &runtime;
+}
+
+RuntimeScope::~RuntimeScope() {
+    current = previous;
+}
+
+Collector& DefaultCollector() {
+    return CurrentRuntime().Gc;
+}
+
+Output& StandardOutput() {
+    return CurrentRuntime().Out;
+}
+
+Input& StandardInput() {
+    return CurrentRuntime().In;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include "Gc.h"
+#include "Input.h"
+#include "Object.h"
+#include "Output.h"
+
+using BuiltinTable = std::unordered_map<std::string, Ref<Builtin>>;
+
+// Everything a running program changes that isn't in its own environments:
+// the collector its objects are tracked by, its builtins, where DISPLAY and
+// SCAN go, and how many statements it has run. Lexers and parsers keep their
+// state in themselves, so with one Runtime per thread a host can lex, parse,
+// compile and run unrelated programs side by side.
+//
+// Values are not shared between Runtimes. Everything made while one is current
+// (environments, functions, compiled constants, which hold its builtins) has
+// to be used on the same thread and dropped before the Runtime is.
+//
+// A parsed Program counts as such a value: its string literals hold their
+// constants and the Resolver writes slots into its identifiers. Each Runtime
+// has to parse its own copy, one Program must never be evaluated or compiled
+// by two Runtimes at once.
+class Runtime {
+public:
+    Runtime(Output& output, Input& input);
+
+    Runtime(const Runtime&) = delete;
+    Runtime& operator=(const Runtime&) = delete;
+
+    Collector Gc; // Destroyed last, after anything below that it tracks
+    BuiltinTable Builtins;
+    Ref<Builtin> Scan; // Builtins["SCAN"], which calls have to tell apart without a lookup
+    Output& Out;
+    Input& In;
+    std::size_t EvaluatedStatements = 0; // Statements run by Eval, for measuring throughput
+};
+
+// The current Runtime of the calling thread. Outside any RuntimeScope that is
+// one of the thread's own over the process's stdout and stdin, which is what
+// the command line interpreter and the REPL use.
+Runtime& CurrentRuntime();
+
+// Makes a Runtime current on this thread for its lifetime
+class RuntimeScope {
+public:
+    explicit RuntimeScope(Runtime& runtime);
+    ~RuntimeScope();
+
+    RuntimeScope(const RuntimeScope&) = delete;
+    RuntimeScope& operator=(const RuntimeScope&) = delete;
+
+private:
+    Runtime* previous;
+};
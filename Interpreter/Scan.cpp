@@ -0,0 +1,231 @@
+#include "Scan.h"
+
+#include <atomic>
+#include <bit>
+
+// SSE2 is part of every x86-64 processor. AVX2 is compiled in next to it and
+// only used after checking the processor at runtime.
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SCAN_SSE2 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define SCAN_AVX2_TARGET
+#else
+#define SCAN_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#else
+#define SCAN_SSE2 0
+#endif
+
+namespace {
+
+// A class of bytes, tested one byte at a time or a block at a time. The block
+// tests set every byte of the result that is in the class to 0xFF.
+
+#if SCAN_SSE2
+__m128i inRange(__m128i bytes, char low, char high) {
+    __m128i offset = _mm_sub_epi8(bytes, _mm_set1_epi8(low));
+    return _mm_cmpeq_epi8(_mm_min_epu8(offset, _mm_set1_epi8(high - low)), offset);
+}
+
+SCAN_AVX2_TARGET __m256i inRange(__m256i bytes, char low, char high) {
+    __m256i offset = _mm256_sub_epi8(bytes, _mm256_set1_epi8(low));
+    return _mm256_cmpeq_epi8(_mm256_min_epu8(offset, _mm256_set1_epi8(high - low)), offset);
+}
+#endif
+
+struct Digits {
+    static bool Match(unsigned char c) { return static_cast<unsigned>(c - '0') < 10u; }
+
+#if SCAN_SSE2
+    static __m128i Match(__m128i bytes) { return inRange(bytes, '0', '9'); }
+    static SCAN_AVX2_TARGET __m256i Match(__m256i bytes) { return inRange(bytes, '0', '9'); }
+#endif
+};
+
+// Lowercasing with | 0x20 folds the two ranges of letters into one, and
+// moves nothing else into it
+struct IdentifierChars {
+    static bool Match(unsigned char c) { return static_cast<unsigned>((c | 0x20) - 'a') < 26u || static_cast<unsigned>(c - '0') < 10u || c == '_'; }
+
+#if SCAN_SSE2
+    static __m128i Match(__m128i bytes) {
+        __m128i letters = inRange(_mm_or_si128(bytes, _mm_set1_epi8(0x20)), 'a', 'z');
+        __m128i underscores = _mm_cmpeq_epi8(bytes, _mm_set1_epi8('_'));
+        return _mm_or_si128(_mm_or_si128(letters, inRange(bytes, '0', '9')), underscores);
+    }
+
+    static SCAN_AVX2_TARGET __m256i Match(__m256i bytes) {
+        __m256i letters = inRange(_mm256_or_si256(bytes, _mm256_set1_epi8(0x20)), 'a', 'z');
+        __m256i underscores = _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('_'));
+        return _mm256_or_si256(_mm256_or_si256(letters, inRange(bytes, '0', '9')), underscores);
+    }
+#endif
+};
+
+// Any of the given bytes
+template <char... Bytes>
+struct OneOf {
+    static bool Match(unsigned char c) { return ((c == static_cast<unsigned char>(Bytes)) || ...); }
+
+#if SCAN_SSE2
+    static __m128i Match(__m128i bytes) {
+        __m128i result = _mm_setzero_si128();
+        ((result = _mm_or_si128(result, _mm_cmpeq_epi8(bytes, _mm_set1_epi8(Bytes)))), ...);
+        return result;
+    }
+
+    static SCAN_AVX2_TARGET __m256i Match(__m256i bytes) {
+        __m256i result = _mm256_setzero_si256();
+        ((result = _mm256_or_si256(result, _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(Bytes)))), ...);
+        return result;
+    }
+#endif
+};
+
+using Spaces = OneOf<' ', '\t', '\r'>;
+
+// The scans stop at the first byte in Class when StopInClass is set, and at
+// the first byte outside it otherwise
+
+template <typename Class, bool StopInClass>
+std::size_t scalarScan(const char* text, std::size_t from, std::size_t size) {
+    while (from < size && Class::Match(static_cast<unsigned char>(text[from])) != StopInClass) {
+        ++from;
+    }
+    return from;
+}
+
+#if SCAN_SSE2
+template <typename Class, bool StopInClass>
+std::size_t sse2Scan(const char* text, std::size_t from, std::size_t size) {
+    for (; from + 16 <= size; from += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + from));
+        unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(Class::Match(block)));
+        if (!StopInClass) {
+            mask = ~mask & 0xFFFF;
+        }
+        if (mask != 0) {
+            return from + std::countr_zero(mask);
+        }
+    }
+    return scalarScan<Class, StopInClass>(text, from, size);
+}
+
+template <typename Class, bool StopInClass>
+SCAN_AVX2_TARGET std::size_t avx2Scan(const char* text, std::size_t from, std::size_t size) {
+    for (; from + 32 <= size; from += 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + from));
+        unsigned int mask = static_cast<unsigned int>(_mm256_movemask_epi8(Class::Match(block)));
+        if (!StopInClass) {
+            mask = ~mask;
+        }
+        if (mask != 0) {
+            return from + std::countr_zero(mask);
+        }
+    }
+    return sse2Scan<Class, StopInClass>(text, from, size);
+}
+#endif
+
+bool cpuHasAvx2() {
+#if !SCAN_SSE2
+    return false;
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+    // The operating system has to save the upper halves of the registers too
+    __cpuid(info, 1);
+    bool osSavesYmm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+    __cpuidex(info, 7, 0);
+    return osSavesYmm && (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init(); // May run before the constructor that does this
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+ScanKernel bestKernel() {
+    if (cpuHasAvx2()) {
+        return ScanKernel::Avx2;
+    }
+    return SCAN_SSE2 ? ScanKernel::Sse2 : ScanKernel::Scalar;
+}
+
+// Read on every scan, from lexers on any thread. Relaxed is enough, each
+// kernel gives the same answers.
+std::atomic<ScanKernel> kernel = bestKernel();
+
+template <typename Class, bool StopInClass>
+std::size_t scan(std::string_view text, std::size_t from) {
+    switch (kernel.load(std::memory_order_relaxed)) {
+#if SCAN_SSE2
+    case ScanKernel::Avx2:
+        return avx2Scan<Class, StopInClass>(text.data(), from, text.size());
+    case ScanKernel::Sse2:
+        return sse2Scan<Class, StopInClass>(text.data(), from, text.size());
+#endif
+    default:
+        return scalarScan<Class, StopInClass>(text.data(), from, text.size());
+    }
+}
+
+}
+
+std::size_t ScanSpaces(std::string_view text, std::size_t from) {
+    return scan<Spaces, false>(text, from);
+}
+
+std::size_t ScanIdentifier(std::string_view text, std::size_t from) {
+    return scan<IdentifierChars, false>(text, from);
+}
+
+std::size_t ScanDigits(std::string_view text, std::size_t from) {
+    return scan<Digits, false>(text, from);
+}
+
+std::size_t ScanString(std::string_view text, std::size_t from) {
+    return scan<OneOf<'"', '[', '\0'>, true>(text, from);
+}
+
+std::size_t ScanLine(std::string_view text, std::size_t from) {
+    return scan<OneOf<'\n', '\0'>, true>(text, from);
+}
+
+ScanKernel CurrentScanKernel() {
+    return kernel.load(std::memory_order_relaxed);
+}
+
+bool ScanKernelSupported(ScanKernel candidate) {
+    switch (candidate) {
+    case ScanKernel::Avx2:
+        return cpuHasAvx2();
+    case ScanKernel::Sse2:
+        return SCAN_SSE2;
+    default:
+        return true;
+    }
+}
+
+bool SetScanKernel(ScanKernel candidate) {
+    if (!ScanKernelSupported(candidate)) {
+        return false;
+    }
+    kernel.store(candidate, std::memory_order_relaxed);
+    return true;
+}
+
+std::string_view ScanKernelName(ScanKernel candidate) {
+    switch (candidate) {
+    case ScanKernel::Avx2:
+        return "avx2";
+    case ScanKernel::Sse2:
+        return "sse2";
+    default:
+        return "scalar";
+    }
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+// Kernels the lexer uses to find where a run of bytes ends: the spaces before
+// a token, the letters of an identifier, the digits of a number, the text of a
+// string or a comment. Long runs are compared 16 or 32 bytes at a time with
+// SSE2 or AVX2 where the processor has them, and one byte at a time otherwise
+// and for the last few bytes of the input, which is never read past.
+//
+// Each function takes the offset the run starts at and returns the offset of
+// the first byte after it, text.size() if the run reaches the end.
+
+enum class ScanKernel {
+    Scalar,
+    Sse2,
+    Avx2,
+};
+
+std::size_t ScanSpaces(std::string_view text, std::size_t from);     // ' ', '\t' and '\r'
+std::size_t ScanIdentifier(std::string_view text, std::size_t from); // Letters, digits and '_'
+std::size_t ScanDigits(std::string_view text, std::size_t from);
+std::size_t ScanString(std::string_view text, std::size_t from);     // Up to '"', '[' or a NUL
+std::size_t ScanLine(std::string_view text, std::size_t from);       // Up to '\n' or a NUL
+
+// The fastest kernel the processor supports is picked at startup. Selecting
+// another one, for tests and benchmarks, fails if it isn't supported. It may
+// be changed while other threads are lexing; their scans switch over at the
+// next call.
+ScanKernel CurrentScanKernel();
+bool SetScanKernel(ScanKernel kernel);
+bool ScanKernelSupported(ScanKernel kernel);
+std::string_view ScanKernelName(ScanKernel kernel);
@@ -0,0 +1,126 @@
+#include "Source.h"
+
+#include <cstdio>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+Source::~Source() {
+    if (mapped == nullptr) {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(mapped);
+#else
+    munmap(const_cast<char*>(mapped), mappedSize);
+#endif
+}
+
+void Source::checkSize(std::size_t size) {
+    if (size > MaxSize) {
+        throw std::length_error("source is " + std::to_string(size) + " bytes, the limit is " + std::to_string(MaxSize));
+    }
+}
+
+// Reads everything left in a stream that can't be mapped (pipes, stdin)
+static std::string readAll(std::FILE* file) {
+    std::string text;
+    char buffer[1 << 16];
+    std::size_t count;
+    while ((count = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        text.append(buffer, count);
+    }
+    return text;
+}
+
+#ifdef _WIN32
+
+SourcePtr Source::Load(const std::string& path) {
+    if (path == "-") {
+        return std::make_shared<Source>(readAll(stdin));
+    }
+
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return nullptr;
+    }
+
+    LARGE_INTEGER size;
+    if (GetFileType(file) == FILE_TYPE_DISK && GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        const void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        // The view keeps the mapping alive on its own
+        if (mapping) {
+            CloseHandle(mapping);
+        }
+        if (view) {
+            CloseHandle(file);
+            SourcePtr source(new Source());
+            source->mapped = static_cast<const char*>(view);
+            source->mappedSize = static_cast<std::size_t>(size.QuadPart);
+            source->text = std::string_view(source->mapped, source->mappedSize);
+            checkSize(source->mappedSize); // After the view belongs to source, which unmaps it
+            return source;
+        }
+    }
+
+    // Not mappable (pipe, empty file): one pass of reads into memory
+    std::string text;
+    char buffer[1 << 16];
+    DWORD count;
+    while (ReadFile(file, buffer, sizeof(buffer), &count, nullptr) && count > 0) {
+        text.append(buffer, count);
+    }
+    CloseHandle(file);
+    return std::make_shared<Source>(std::move(text));
+}
+
+#else
+
+SourcePtr Source::Load(const std::string& path) {
+    if (path == "-") {
+        return std::make_shared<Source>(readAll(stdin));
+    }
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+        std::size_t size = static_cast<std::size_t>(info.st_size);
+        void* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (view != MAP_FAILED) {
+            close(fd); // The mapping keeps its own reference to the file
+            madvise(view, size, MADV_SEQUENTIAL);
+            SourcePtr source(new Source());
+            source->mapped = static_cast<const char*>(view);
+            source->mappedSize = size;
+            source->text = std::string_view(source->mapped, size);
+            checkSize(size); // After the mapping belongs to source, which unmaps it
+            return source;
+        }
+    }
+
+    // Not mappable (pipe, FIFO, empty file): one pass of reads into memory
+    std::string text;
+    char buffer[1 << 16];
+    ssize_t count;
+    while ((count = read(fd, buffer, sizeof(buffer))) > 0) {
+        text.append(buffer, static_cast<std::size_t>(count));
+    }
+    close(fd);
+    return std::make_shared<Source>(std::move(text));
+}
+
+#endif
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+class Source;
+using SourcePtr = std::shared_ptr<Source>;
+
+// Program text shared by the lexer and everything that keeps tokens around.
+// Token literals are views into Text(), or into the interned strings for the
+// few literals the lexer has to build itself (strings with escapes, floats).
+// Anything holding tokens past the parse (Program, FunctionLiteral, Function)
+// keeps a reference to the Source so those stay valid.
+class Source {
+public:
+    // Largest text there can be. Token offsets are 31 bits (TokenStream), a
+    // longer text throws std::length_error.
+    static constexpr std::size_t MaxSize = 0x7FFFFFFF;
+
+    explicit Source(std::string text) : owned(std::move(text)), text(owned) {
+        checkSize(this->text.size());
+    }
+    ~Source();
+
+    Source(const Source&) = delete;
+    Source& operator=(const Source&) = delete;
+
+    // Maps a script file read-only so the lexer works on the page cache
+    // directly. Pipes, character devices and "-" (stdin) can't be mapped and
+    // are read into memory instead. Returns nullptr if the file can't be opened,
+    // and throws std::length_error if it is over MaxSize.
+    static SourcePtr Load(const std::string& path);
+
+    std::string_view Text() const {
+        return text;
+    }
+
+    // Stores a literal that is not a slice of the text. A deque never moves
+    // its elements, so views handed out earlier stay valid. Lexers working on
+    // parts of the text in parallel may call this at the same time.
+    std::string_view Intern(std::string value) {
+        std::lock_guard<std::mutex> lock(internLock);
+        return interned.emplace_back(std::move(value));
+    }
+
+private:
+    Source() = default;
+
+    static void checkSize(std::size_t size);
+
+    std::string owned;                 // Text read into memory, empty when mapped
+    std::string_view text;
+    const char* mapped = nullptr;      // Start of the file mapping, if any
+    std::size_t mappedSize = 0;
+    std::deque<std::string> interned;
+    std::mutex internLock;
+};
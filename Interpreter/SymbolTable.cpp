@@ -0,0 +1,63 @@
+#include "SymbolTable.h"
+
+SymbolTable* SymbolTable::frameTable() {
+    SymbolTable* table = this;
+    while (table->IsBlock && table->Outer) {
+        table = table->Outer.get();
+    }
+    return table;
+}
+
+Symbol SymbolTable::Define(const std::string& name) {
+    SymbolTable* frame = frameTable();
+
+    Symbol symbol;
+    if (frame == this && Outer == nullptr) {
+        symbol = { name, SymbolScope::GLOBAL, NumDefinitions++ };
+        GlobalNames.push_back(name);
+    }
+    else {
+        symbol = { name, SymbolScope::LOCAL, frame->NumLocals++ };
+        frame->LocalNames.push_back(name);
+    }
+
+    store[name] = symbol;
+    return symbol;
+}
+
+Symbol SymbolTable::DefineFunctionName(const std::string& name) {
+    Symbol symbol = { name, SymbolScope::FUNCTION, 0 };
+    store[name] = symbol;
+    return symbol;
+}
+
+Symbol SymbolTable::defineFree(const Symbol& original) {
+    FreeSymbols.push_back(original);
+
+    Symbol symbol = { original.Name, SymbolScope::FREE, static_cast<int>(FreeSymbols.size()) - 1 };
+    store[original.Name] = symbol;
+    return symbol;
+}
+
+std::optional<Symbol> SymbolTable::Resolve(const std::string& name) {
+    auto it = store.find(name);
+    if (it != store.end()) {
+        return it->second;
+    }
+    if (Outer == nullptr) {
+        return std::nullopt;
+    }
+
+    auto symbol = Outer->Resolve(name);
+    if (!symbol) {
+        return std::nullopt;
+    }
+
+    // Blocks share the frame of the enclosing table, and globals are reachable from anywhere
+    if (IsBlock || symbol->Scope == SymbolScope::GLOBAL) {
+        return symbol;
+    }
+
+    // Crossing a function boundary, capture the variable
+    return defineFree(*symbol);
+}
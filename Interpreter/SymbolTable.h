@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+
+enum class SymbolScope {
+    GLOBAL,   // Top level declarations
+    LOCAL,    // Function parameters/declarations and WHILE body declarations
+    FREE,     // Locals of an enclosing function, captured by a closure
+    FUNCTION, // The function currently being compiled (self reference)
+};
+
+struct Symbol {
+    std::string Name;
+    SymbolScope Scope;
+    int Index;
+};
+
+// One table per function and one per WHILE body. A WHILE body gets a fresh
+// environment on every iteration in the tree-walker, so its declarations live
+// in their own table but share the local slots of the enclosing frame.
+class SymbolTable {
+public:
+    std::shared_ptr<SymbolTable> Outer;
+    bool IsBlock = false;
+
+    int NumDefinitions = 0; // Globals, only used by the top level table
+    int NumLocals = 0;      // Frame slots, including the ones handed out to nested blocks
+    std::vector<Symbol> FreeSymbols;
+
+    // Slot names, for error messages
+    std::vector<std::string> GlobalNames;
+    std::vector<std::string> LocalNames;
+
+    SymbolTable() = default;
+    SymbolTable(std::shared_ptr<SymbolTable> outer, bool isBlock) : Outer(std::move(outer)), IsBlock(isBlock) {}
+
+    Symbol Define(const std::string& name);
+    Symbol DefineFunctionName(const std::string& name);
+    std::optional<Symbol> Resolve(const std::string& name);
+
+private:
+    std::unordered_map<std::string, Symbol> store;
+
+    SymbolTable* frameTable();
+    Symbol defineFree(const Symbol& original);
+};
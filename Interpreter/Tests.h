@@ -3,6 +3,7 @@
 #include "tests/parser_test.h"
 #include "tests/ast_test.h"
 #include "tests/evaluator_test.h"
+#include "tests/vm_test.h"
 
 void ExecuteTestCases() {
 
@@ -19,6 +20,12 @@ void ExecuteTestCases() {
     //std::cout << "Test 3: " << std::endl;
     //TestNextToken3();
 
+    //TestKeywords();
+    //TestScanKernels();
+    //TestTokenStream();
+    //TestCrlfLineEndings();
+    //TestParallelLexing();
+
     // Testing for parser
     //TestTypedDeclStatements();
     //TestTypedDeclStatementsV2_1();
@@ -60,4 +67,20 @@ void ExecuteTestCases() {
     //TestStringConcatenation();
     //TestCharLiteral();
     //TestBuiltinFunctions();
+    //TestGarbageCollection();
+    //TestConcurrentPrograms();
+    //TestErrorLines();
+
+    // Testing for bytecode compiler and VM
+    //TestCompilerInstructions();
+    //TestVMIntegerArithmetic();
+    //TestVMBooleanExpressions();
+    //TestVMConditionals();
+    //TestVMTypedDeclStatements();
+    //TestVMWhileLoop();
+    //TestVMFunctions();
+    //TestVMRecursiveFunctions();
+    //TestVMStackOverflow();
+    //TestVMMatchesEvaluator();
+    //TestVMOperandLimits();
 }
\ No newline at end of file
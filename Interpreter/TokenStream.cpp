@@ -0,0 +1,149 @@
+#include "TokenStream.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+TokenStream::TokenStream(const SourcePtr& source) : source(source), text(source->Text()) {}
+
+TokenStream::TokenStream(Lexer& lexer) : TokenStream(lexer.GetSource()) {
+    // About one token for every five bytes of typical source
+    std::size_t expected = text.size() / 5 + 1;
+    types.reserve(expected);
+    offsets.reserve(expected);
+    lengths.reserve(expected);
+    lines.reserve(expected);
+
+    lexUntil(lexer, text.size() + 1);
+}
+
+bool TokenStream::lexUntil(Lexer& lexer, std::size_t end) {
+    while (lexer.Position() < end) {
+        Token token = lexer.NextToken();
+        types.push_back(token.Type);
+        lines.push_back(token.Line);
+        lengths.push_back(static_cast<uint32_t>(token.Literal.size()));
+
+        const char* literal = token.Literal.data();
+        if (token.Literal.empty()) {
+            offsets.push_back(0);
+        }
+        else if (literal >= text.data() && literal + token.Literal.size() <= text.data() + text.size()) {
+            offsets.push_back(static_cast<uint32_t>(literal - text.data()));
+        }
+        else {
+            offsets.push_back(External | static_cast<uint32_t>(external.size()));
+            external.push_back(token.Literal);
+        }
+
+        if (token.Type == EOF_TOKEN) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string_view TokenStream::Literal(std::size_t index) const {
+    index = clamp(index);
+    uint32_t offset = offsets[index];
+    if (offset & External) {
+        return external[offset & ~External];
+    }
+    return text.substr(offset, lengths[index]);
+}
+
+void TokenStream::append(const TokenStream& chunk, uint32_t firstLine) {
+    auto externalBase = static_cast<uint32_t>(external.size());
+    external.insert(external.end(), chunk.external.begin(), chunk.external.end());
+
+    types.insert(types.end(), chunk.types.begin(), chunk.types.end());
+    lengths.insert(lengths.end(), chunk.lengths.begin(), chunk.lengths.end());
+    for (uint32_t offset : chunk.offsets) {
+        offsets.push_back(offset & External ? offset + externalBase : offset);
+    }
+    for (uint32_t line : chunk.lines) {
+        lines.push_back(line + firstLine - 1);
+    }
+}
+
+TokenStream TokenStream::LexParallel(const SourcePtr& source, std::size_t chunkSize, unsigned int threads) {
+    std::string_view text = source->Text();
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    chunkSize = std::max<std::size_t>(chunkSize, 1);
+    if (threads == 1 || text.size() <= chunkSize) {
+        Lexer lexer(source);
+        return TokenStream(lexer);
+    }
+
+    // Cut just after the first '\n' at or past every chunkSize bytes
+    std::vector<std::size_t> starts = { 0 };
+    while (starts.back() + chunkSize < text.size()) {
+        std::size_t newline = text.find('\n', starts.back() + chunkSize);
+        if (newline == std::string_view::npos || newline + 1 >= text.size()) {
+            break;
+        }
+        starts.push_back(newline + 1);
+    }
+    starts.push_back(text.size() + 1); // Past the end, so the last chunk takes the EOF_TOKEN
+
+    struct Chunk {
+        TokenStream tokens;
+        std::size_t reached = 0; // Where its lexer stopped, past the end if a token ran over
+        uint32_t lines = 0;      // Line count of the chunk as lexed, from 1
+        bool eof = false;
+    };
+    std::size_t count = starts.size() - 1;
+    std::vector<Chunk> chunks;
+    chunks.reserve(count);
+    for (std::size_t i = 0; i < count; i++) {
+        chunks.push_back(Chunk{ TokenStream(source) });
+    }
+
+    // Workers take the next chunk until there are none left
+    std::atomic<std::size_t> next = 0;
+    auto work = [&] {
+        for (std::size_t i = next++; i < count; i = next++) {
+            Lexer lexer(source, starts[i], 1);
+            chunks[i].eof = chunks[i].tokens.lexUntil(lexer, starts[i + 1]);
+            chunks[i].reached = lexer.Position();
+            chunks[i].lines = lexer.Line();
+        }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned int i = 1; i < std::min<std::size_t>(threads, count); i++) {
+        pool.emplace_back(work);
+    }
+    work();
+    for (auto& thread : pool) {
+        thread.join();
+    }
+
+    // A chunk's tokens are right if the chunks before it ended exactly at its
+    // start. Otherwise a token ran over the cut, and from where it ended the
+    // lexing goes on here until it lands on a later cut.
+    TokenStream result(source);
+    std::size_t reached = 0;
+    uint32_t line = 1;
+    for (std::size_t i = 0; i < count; i++) {
+        if (reached == starts[i]) {
+            result.append(chunks[i].tokens, line);
+            reached = chunks[i].reached;
+            line += chunks[i].lines - 1;
+            if (chunks[i].eof) {
+                break;
+            }
+        }
+        else if (reached < starts[i + 1]) {
+            Lexer lexer(source, reached, line);
+            bool eof = result.lexUntil(lexer, starts[i + 1]);
+            reached = lexer.Position();
+            line = lexer.Line();
+            if (eof) {
+                break;
+            }
+        }
+    }
+    return result;
+}
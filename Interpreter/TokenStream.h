@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include "Lexer.h"
+#include "Source.h"
+#include "Token.h"
+
+// Every token of a Source, lexed up front into one array per field. The
+// parser walks it by index, so any token ahead can be looked at without
+// running the lexer again, and the kinds of a whole file sit next to each
+// other in memory. Lexing and parsing can also be timed on their own.
+//
+// A literal is kept as an offset and length into the text. The few that
+// aren't slices of the text (strings with escapes, spellings the lexer
+// supplies such as "==") are kept aside and the offset points there instead.
+class TokenStream {
+public:
+    // Runs lexer to the end of its input. The last token is always EOF_TOKEN.
+    explicit TokenStream(Lexer& lexer);
+
+    // Below this size a file is lexed on the calling thread
+    static constexpr std::size_t DefaultChunkSize = 4 * 1024 * 1024;
+
+    // The same tokens as TokenStream(Lexer(source)), lexed on several threads.
+    // The text is cut into chunks of about chunkSize bytes just after a '\n',
+    // and each chunk is lexed as if a token started there. That is true unless
+    // the '\n' is inside a string, a char literal or an [escape]; the chunk
+    // before then runs over the cut, and the stitching lexes on from where it
+    // stopped. threads = 0 uses one per core.
+    static TokenStream LexParallel(const SourcePtr& source, std::size_t chunkSize = DefaultChunkSize, unsigned int threads = 0);
+
+    // Number of tokens, counting the EOF_TOKEN
+    std::size_t Size() const { return types.size(); }
+
+    TokenType Type(std::size_t index) const { return types[clamp(index)]; }
+    uint32_t Line(std::size_t index) const { return lines[clamp(index)]; }
+    std::string_view Literal(std::size_t index) const;
+
+    // Indexes past the end give the EOF_TOKEN again, as the lexer would
+    Token At(std::size_t index) const {
+        index = clamp(index);
+        return Token(types[index], Literal(index), lines[index]);
+    }
+
+    // The text and interned literals the tokens point into
+    const SourcePtr& GetSource() const { return source; }
+
+private:
+    static constexpr uint32_t External = 0x80000000; // Set in offsets[i] for literals kept aside
+    static_assert(Source::MaxSize < External, "offsets into the text must leave the External bit clear");
+
+    SourcePtr source;
+    std::string_view text;
+    std::vector<TokenType> types;
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> lengths;
+    std::vector<uint32_t> lines;
+    std::vector<std::string_view> external;
+
+    explicit TokenStream(const SourcePtr& source);
+
+    // Adds tokens from lexer until it reaches offset end or the EOF_TOKEN,
+    // and returns whether that was added
+    bool lexUntil(Lexer& lexer, std::size_t end);
+
+    // Adds the tokens of a chunk that was lexed counting lines from 1
+    void append(const TokenStream& chunk, uint32_t firstLine);
+
+    std::size_t clamp(std::size_t index) const {
+        return index < types.size() ? index : types.size() - 1;
+    }
+};
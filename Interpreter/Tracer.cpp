@@ -0,0 +1,55 @@
+#include "Tracer.h"
+
+#if INTERPRETER_TRACING
+
+#include <chrono>
+#include <string>
+
+namespace {
+
+// Per thread, so programs running side by side don't interleave their calls
+thread_local std::array<TraceEvent, Tracer::Capacity> events;
+thread_local std::size_t recorded = 0; // Total ever recorded, the next one goes to recorded % Capacity
+thread_local uint32_t depth = 0;
+thread_local std::chrono::steady_clock::time_point start;
+
+}
+
+void Tracer::record(const char* name, bool enter) {
+    auto now = std::chrono::steady_clock::now();
+    if (recorded == 0) {
+        start = now;
+    }
+    if (!enter && depth > 0) {
+        --depth;
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(now - start).count();
+    events[recorded % Capacity] = TraceEvent{ name, static_cast<uint64_t>(elapsed), depth, enter };
+    ++recorded;
+
+    if (enter) {
+        ++depth;
+    }
+}
+
+void Tracer::Dump(std::ostream& out) {
+    std::size_t first = recorded > Capacity ? recorded - Capacity : 0;
+    if (first > 0) {
+        out << "(" << first << " earlier events dropped)\n";
+    }
+
+    for (std::size_t i = first; i < recorded; ++i) {
+        const TraceEvent& event = events[i % Capacity];
+        out << event.Nanoseconds / 1000 << "us " << std::string(event.Depth * 2, ' ')
+            << (event.Enter ? "Entering " : "Exiting ") << event.Name << "\n";
+    }
+    out.flush();
+}
+
+void Tracer::Clear() {
+    recorded = 0;
+    depth = 0;
+}
+
+#endif
@@ -1,34 +1,79 @@
 #pragma once
 
-#include <iostream>
-#include <string>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
 
+// Tracing is compiled in for debug builds and removed from release builds,
+// where Tracer is an empty object the optimizer drops. INTERPRETER_TRACING
+// can force it either way.
+#ifndef INTERPRETER_TRACING
+#ifdef NDEBUG
+#define INTERPRETER_TRACING 0
+#else
+#define INTERPRETER_TRACING 1
+#endif
+#endif
+
+// One enter or exit of a traced function
+struct TraceEvent {
+    const char* Name;
+    uint64_t Nanoseconds; // Since the first event
+    uint32_t Depth;
+    bool Enter;
+};
+
+#if INTERPRETER_TRACING
+
+// Records entering and leaving the function it is declared in, when trace is
+// set. Events go to a ring buffer in memory rather than to the console, so
+// the timing of a large parse is not dominated by printing it, and Dump
+// writes out the most recent ones afterwards. Names must be string literals.
 class Tracer {
 public:
-    static int indentLevel;
-    static bool trace;
+    static constexpr std::size_t Capacity = 4096; // Oldest events are overwritten
 
-    Tracer(const std::string& functionName) : funcName(functionName) {
+    inline static bool trace = false; // Set to true for function tracing
+
+    explicit Tracer(const char* functionName) : funcName(functionName) {
         if (trace) {
-            printIndent("Entering " + funcName + "\n");
-            ++indentLevel; 
+            record(funcName, true);
         }
     }
 
     ~Tracer() {
         if (trace) {
-            --indentLevel; 
-            printIndent("Exiting " + funcName + "\n");
+            record(funcName, false);
         }
     }
 
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+
+    static void SetEnabled(bool enabled) { trace = enabled; }
+
+    // Prints the calling thread's buffered events, oldest first, indented by depth
+    static void Dump(std::ostream& out);
+    static void Clear();
+
 private:
-    std::string funcName;
+    const char* funcName;
 
-    void printIndent(const std::string& message) {
-        std::cout << std::string(indentLevel * 2, ' ') << message;
-    }
+    static void record(const char* name, bool enter);
+};
+
+#else
+
+class Tracer {
+public:
+    static constexpr bool trace = false;
+
+    explicit constexpr Tracer(const char*) {}
+
+    static void SetEnabled(bool) {}
+    static void Dump(std::ostream&) {}
+    static void Clear() {}
 };
 
-int Tracer::indentLevel = 0;
-bool Tracer::trace = false; // Set to true for function tracing;
+#endif
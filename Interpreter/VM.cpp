@@ -0,0 +1,559 @@
+#include "VM.h"
+#include "Evaluator.h"
+
+#include <algorithm>
+
+VM::VM(const Bytecode& bytecode)
+    : constants(bytecode.Constants),
+      globals(bytecode.NumGlobals),
+      globalNames(bytecode.GlobalNames),
+      statementStarts(bytecode.StatementStarts),
+      stack(std::max(StackSize, static_cast<size_t>(bytecode.MaxStack))),
+      locals(bytecode.NumLocals) {
+
+    // The program itself runs as a function without parameters. Its code gets
+    // the OpReturn every function ends with, so Run never looks for the end.
+    auto mainFn = MakeRef<CompiledFunction>("", bytecode.Instructions_, bytecode.NumLocals, 0);
+    mainFn->Code.push_back(static_cast<uint8_t>(OpCode::OpReturn));
+    mainFn->LocalNames = bytecode.LocalNames;
+    mainFn->MaxStack = bytecode.MaxStack;
+
+    frames.reserve(MaxFrames);
+    frames.push_back(Frame{ MakeRef<Closure>(mainFn, std::vector<Ref<Cell>>{}), 0, 0, 0 });
+}
+
+Value VM::LastPoppedStackElem() const {
+    return lastPopped;
+}
+
+// Calls check that the stack has room for everything the callee pushes
+void VM::push(Value value) {
+    stack[sp++] = std::move(value);
+}
+
+Value VM::pop() {
+    return std::move(stack[--sp]);
+}
+
+bool VM::fail(Value raised) {
+    error = std::move(raised);
+    return false;
+}
+
+bool VM::fail(std::string message) {
+    return fail(MakeRef<ErrorObject>(std::move(message)));
+}
+
+void VM::Run() {
+    Collector& gc = CurrentRuntime().Gc;
+
+    // The running frame's state lives in these locals. It is written back to
+    // the Frame and read again only when a call, a return or an error changes
+    // which frame runs.
+    Frame* frame = nullptr;
+    const uint8_t* code = nullptr;
+    const uint8_t* ip = nullptr;
+    Local* frameLocals = nullptr;
+
+    auto enterFrame = [&] {
+        frame = &frames.back();
+        code = frame->Cl->Fn->Code.data();
+        ip = code + frame->Ip;
+        frameLocals = locals.data() + frame->LocalsBase;
+    };
+    auto saveIp = [&] {
+        frame->Ip = static_cast<size_t>(ip - code);
+    };
+
+    enterFrame();
+    for (;;) {
+        // Every instruction continues the loop, only the ones that raise an
+        // error leave the switch, through goto raise
+        switch (static_cast<OpCode>(*ip)) {
+        case OpCode::OpConstant:
+            push(constants[ReadUint32(ip + 1)]);
+            ip += 5;
+            continue;
+
+        case OpCode::OpPop:
+            lastPopped = pop();
+            ip += 1;
+            continue;
+
+        case OpCode::OpAdd:
+        case OpCode::OpSub:
+        case OpCode::OpMul:
+        case OpCode::OpDiv:
+        case OpCode::OpConcat:
+        case OpCode::OpEqual:
+        case OpCode::OpNotEqual:
+        case OpCode::OpLessThan:
+        case OpCode::OpGreaterThan: {
+            OpCode op = static_cast<OpCode>(*ip);
+            ip += 1;
+            if (!executeBinaryOperation(op)) {
+                goto raise;
+            }
+            continue;
+        }
+
+        case OpCode::OpMinus:
+        case OpCode::OpBang: {
+            OpCode op = static_cast<OpCode>(*ip);
+            ip += 1;
+            if (!executePrefixOperation(op)) {
+                goto raise;
+            }
+            continue;
+        }
+
+        case OpCode::OpTrue:
+            push(Value::Boolean(true));
+            ip += 1;
+            continue;
+
+        case OpCode::OpFalse:
+            push(Value::Boolean(false));
+            ip += 1;
+            continue;
+
+        case OpCode::OpNull:
+            push(Value::Null());
+            ip += 1;
+            continue;
+
+        case OpCode::OpJump:
+            ip = code + ReadUint32(ip + 1);
+            continue;
+
+        case OpCode::OpJumpNotTruthy:
+            ip = pop().IsTruthy() ? ip + 5 : code + ReadUint32(ip + 1);
+            continue;
+
+        case OpCode::OpGetGlobal: {
+            uint16_t index = ReadUint16(ip + 1);
+            ip += 3;
+            const Binding& binding = globals[index];
+            if (binding.Value) {
+                push(binding.Value);
+            }
+            else if (!pushUnset(globalNames[index])) {
+                goto raise;
+            }
+            continue;
+        }
+
+        case OpCode::OpDeclareGlobal: {
+            uint16_t index = ReadUint16(ip + 1);
+            uint8_t type = ip[3];
+            DeclareMode mode = static_cast<DeclareMode>(ip[4]);
+            ip += 5;
+            if (!executeDeclare(globals[index], type, mode, globalNames[index])) {
+                goto raise;
+            }
+            continue;
+        }
+
+        case OpCode::OpAssignGlobal: {
+            uint16_t index = ReadUint16(ip + 1);
+            ip += 3;
+            if (!executeAssign(globals[index], globalNames[index])) {
+                goto raise;
+            }
+            continue;
+        }
+
+        case OpCode::OpGetLocal: {
+            uint16_t index = ReadUint16(ip + 1);
+            ip += 3;
+            const Binding& binding = frameLocals[index].Slot();
+            if (binding.Value) {
+                push(binding.Value);
+            }
+            else if (!pushUnset(frame->Cl->Fn->LocalNames[index])) {
+                goto raise;
+            }
+            continue;
+        }
+
+        case OpCode::OpDeclareLocal: {
+            uint16_t index = ReadUint16(ip + 1);
+            uint8_t type = ip[3];
+            DeclareMode mode = static_cast<DeclareMode>(ip[4]);
+            ip += 5;
+            if (!executeDeclare(frameLocals[index].Slot(), type, mode, frame->Cl->Fn->LocalNames[index])) {
+                goto raise;
+            }
+            continue;
+        }
+
+        case OpCode::OpAssignLocal: {
+            uint16_t index = ReadUint16(ip + 1);
+            ip += 3;
+            if (!executeAssign(frameLocals[index].Slot(), frame->Cl->Fn->LocalNames[index])) {
+                goto raise;
+            }
+            continue;
+        }
+
+        case OpCode::OpClearLocals: {
+            // Closures made in the last iteration keep the cells they captured
+            Local* first = frameLocals + ReadUint16(ip + 1);
+            std::fill(first, first + ReadUint16(ip + 3), Local{});
+            ip += 5;
+            continue;
+        }
+
+        case OpCode::OpGetFree: {
+            uint8_t index = ip[1];
+            ip += 2;
+            const Binding& binding = frame->Cl->Free[index]->Slot;
+            if (binding.Value) {
+                push(binding.Value);
+            }
+            else if (!pushUnset(frame->Cl->Fn->Captures[index].Name)) {
+                goto raise;
+            }
+            continue;
+        }
+
+        case OpCode::OpDeclareFree: {
+            uint8_t index = ip[1];
+            uint8_t type = ip[2];
+            DeclareMode mode = static_cast<DeclareMode>(ip[3]);
+            ip += 4;
+            if (!executeDeclare(frame->Cl->Free[index]->Slot, type, mode, frame->Cl->Fn->Captures[index].Name)) {
+                goto raise;
+            }
+            continue;
+        }
+
+        case OpCode::OpAssignFree: {
+            uint8_t index = ip[1];
+            ip += 2;
+            if (!executeAssign(frame->Cl->Free[index]->Slot, frame->Cl->Fn->Captures[index].Name)) {
+                goto raise;
+            }
+            continue;
+        }
+
+        case OpCode::OpCurrentClosure:
+            push(frame->Cl);
+            ip += 1;
+            continue;
+
+        case OpCode::OpClosure: {
+            auto fn = StaticRefCast<CompiledFunction>(constants[ReadUint32(ip + 1)].AsObject());
+            ip += 5;
+
+            std::vector<Ref<Cell>> free;
+            free.reserve(fn->Captures.size());
+            for (const auto& capture : fn->Captures) {
+                switch (capture.From) {
+                case Capture::Kind::Local: {
+                    Local& local = frameLocals[capture.Index];
+                    if (!local.Captured) {
+                        local.Captured = MakeRef<Cell>(std::move(local.Own));
+                        local.Own = Binding{};
+                    }
+                    free.push_back(local.Captured);
+                    break;
+                }
+                case Capture::Kind::Free:
+                    free.push_back(frame->Cl->Free[capture.Index]);
+                    break;
+                case Capture::Kind::CurrentClosure:
+                    free.push_back(MakeRef<Cell>(Binding{ FUNCTION, frame->Cl }));
+                    break;
+                }
+            }
+
+            // Closures are the only tracked objects the VM makes
+            gc.MaybeCollect();
+            push(MakeRef<Closure>(std::move(fn), std::move(free)));
+            continue;
+        }
+
+        case OpCode::OpCall: {
+            size_t numArgs = ip[1];
+            ip += 2;
+            saveIp();
+            if (!executeCall(numArgs)) {
+                goto raise;
+            }
+            enterFrame();
+            continue;
+        }
+
+        case OpCode::OpReturnValue:
+            if (frames.size() == 1) {
+                // RETURN at the top level ends the program
+                lastPopped = pop();
+                return;
+            }
+            returnFromFrame(pop());
+            enterFrame();
+            continue;
+
+        case OpCode::OpReturn:
+            if (frames.size() == 1) {
+                return;
+            }
+            returnFromFrame(Value::Null());
+            enterFrame();
+            continue;
+
+        case OpCode::OpScanGlobal: {
+            uint16_t index = ReadUint16(ip + 1);
+            ip += 3;
+            if (!executeScan(globals[index])) {
+                goto raise;
+            }
+            continue;
+        }
+
+        case OpCode::OpScanLocal: {
+            uint16_t index = ReadUint16(ip + 1);
+            ip += 3;
+            if (!executeScan(frameLocals[index].Slot())) {
+                goto raise;
+            }
+            continue;
+        }
+
+        case OpCode::OpScanFree: {
+            uint8_t index = ip[1];
+            ip += 2;
+            if (!executeScan(frame->Cl->Free[index]->Slot)) {
+                goto raise;
+            }
+            continue;
+        }
+
+        case OpCode::OpRaise:
+            error = constants[ReadUint32(ip + 1)];
+            ip += 5;
+            goto raise;
+
+        default:
+            // Where the next instruction starts is unknown, so nothing more can run
+            StandardOutput().Write("Error: Unknown opcode ").Write(static_cast<int>(*ip)).EndLine();
+            return;
+        }
+
+    raise:
+        saveIp();
+        if (!recover()) {
+            return;
+        }
+        enterFrame();
+    }
+}
+
+// Prints the error and skips to the next top level statement, dropping any
+// function calls in progress. Returns false when there is nothing left to run.
+bool VM::recover() {
+    if (auto err = error.As<ErrorObject>()) {
+        StandardOutput().Write(err->Message).EndLine();
+    }
+    error = nullptr;
+
+    frames.resize(1);
+    locals.resize(frames[0].Cl->Fn->NumLocals);
+    for (size_t i = 0; i < sp; ++i) {
+        stack[i] = nullptr;
+    }
+    sp = 0;
+
+    Frame& main = frames[0];
+    for (size_t start : statementStarts) {
+        if (start >= main.Ip) {
+            main.Ip = start;
+            return true;
+        }
+    }
+    return false;
+}
+
+void VM::returnFromFrame(Value value) {
+    Frame frame = std::move(frames.back());
+    frames.pop_back();
+
+    locals.resize(frame.LocalsBase);
+    while (sp > frame.StackBase) {
+        stack[--sp] = nullptr;
+    }
+    push(std::move(value));
+}
+
+// A variable that has no value yet, same lookup order as evalIdentifier
+bool VM::pushUnset(const std::string& name) {
+    const BuiltinTable& builtins = CurrentRuntime().Builtins;
+    auto it = builtins.find(name);
+    if (it != builtins.end()) {
+        push(it->second);
+        return true;
+    }
+    return fail("Error: Identifier not found '" + name + "'");
+}
+
+static std::string_view operatorSymbol(OpCode op) {
+    switch (op) {
+    case OpCode::OpAdd: return "+";
+    case OpCode::OpSub: return "-";
+    case OpCode::OpMul: return "*";
+    case OpCode::OpDiv: return "/";
+    case OpCode::OpConcat: return "&";
+    case OpCode::OpEqual: return "==";
+    case OpCode::OpNotEqual: return "<>";
+    case OpCode::OpLessThan: return "<";
+    case OpCode::OpGreaterThan: return ">";
+    default: return "";
+    }
+}
+
+// Integer operands, by far the most common, are worked on where they lie on
+// the stack. Everything else goes to evalInfixExpression, which dispatches on
+// the operand tags the way the evaluator does.
+bool VM::executeBinaryOperation(OpCode op) {
+    Value& left = stack[sp - 2];
+    const Value& right = stack[sp - 1];
+
+    if (left.IsInteger() && right.IsInteger()) {
+        int leftVal = left.AsInteger();
+        int rightVal = right.AsInteger();
+
+        switch (op) {
+        case OpCode::OpAdd: left = Value::Integer(leftVal + rightVal); --sp; return true;
+        case OpCode::OpSub: left = Value::Integer(leftVal - rightVal); --sp; return true;
+        case OpCode::OpMul: left = Value::Integer(leftVal * rightVal); --sp; return true;
+        case OpCode::OpDiv: left = rightVal == 0 ? Value::Null() : Value::Integer(leftVal / rightVal); --sp; return true;
+        case OpCode::OpLessThan: left = Value::Boolean(leftVal < rightVal); --sp; return true;
+        case OpCode::OpGreaterThan: left = Value::Boolean(leftVal > rightVal); --sp; return true;
+        case OpCode::OpEqual: left = Value::Boolean(leftVal == rightVal); --sp; return true;
+        case OpCode::OpNotEqual: left = Value::Boolean(leftVal != rightVal); --sp; return true;
+        default: break;
+        }
+    }
+
+    auto rightValue = pop();
+    auto leftValue = pop();
+    auto result = evalInfixExpression(operatorSymbol(op), leftValue, rightValue);
+    if (result.Is(ObjectType_::ERROR_OBJ)) {
+        return fail(std::move(result));
+    }
+    push(std::move(result));
+    return true;
+}
+
+bool VM::executePrefixOperation(OpCode op) {
+    auto right = pop();
+
+    auto result = evalPrefixExpression(op == OpCode::OpBang ? "!" : "-", right);
+    if (result.Is(ObjectType_::ERROR_OBJ)) {
+        return fail(std::move(result));
+    }
+    push(std::move(result));
+    return true;
+}
+
+bool VM::executeCall(size_t numArgs) {
+    size_t calleeSlot = sp - 1 - numArgs;
+    const Value& callee = stack[calleeSlot];
+
+    if (auto cl = callee.AsRef<Closure>()) {
+        const CompiledFunction& fn = *cl->Fn;
+        if (numArgs != static_cast<size_t>(fn.NumParameters)) {
+            return fail("wrong number of arguments. got=" + std::to_string(numArgs) + ", want=" + std::to_string(fn.NumParameters));
+        }
+        if (frames.size() >= MaxFrames) {
+            return fail("Error: Maximum call depth exceeded in " + fn.Name);
+        }
+        // The callee's operands start at its own slot, this is the only
+        // check that they fit
+        if (calleeSlot + fn.MaxStack > stack.size()) {
+            return fail("Error: Stack overflow in " + fn.Name);
+        }
+
+        size_t localsBase = locals.size();
+        locals.resize(localsBase + fn.NumLocals);
+
+        // Parameters carry no declared type, like in extendFunctionEnv
+        for (size_t i = 0; i < numArgs; ++i) {
+            locals[localsBase + i].Own = Binding{ FUNCTION, std::move(stack[calleeSlot + 1 + i]) };
+        }
+        while (sp > calleeSlot) {
+            stack[--sp] = nullptr;
+        }
+
+        frames.push_back(Frame{ std::move(cl), 0, localsBase, calleeSlot });
+        return true;
+    }
+
+    if (auto builtin = callee.AsRef<Builtin>()) {
+        // SCAN reached here was called indirectly, its Fn reports the error
+        std::vector<Value> args(stack.begin() + calleeSlot + 1, stack.begin() + sp);
+        while (sp > calleeSlot) {
+            stack[--sp] = nullptr;
+        }
+
+        auto result = builtin->Fn(args, nullptr);
+        if (result.Is(ObjectType_::ERROR_OBJ)) {
+            return fail(std::move(result));
+        }
+        push(result ? std::move(result) : Value::Null());
+        return true;
+    }
+
+    return fail("not a function: " + callee.Inspect());
+}
+
+bool VM::executeDeclare(Binding& binding, uint8_t typeIndex, DeclareMode mode, const std::string& name) {
+    auto value = pop();
+    const TokenType& type = DeclaredTypes()[typeIndex];
+
+    if (mode != DeclareMode::Unchecked && !isTypeCompatible(type, value)) {
+        if (mode == DeclareMode::Lenient) {
+            StandardOutput().Write("Error: Type mismatch for '").Write(name).Write("': expected ").Write(TokenTypeName(type)).Write(", got ").Write(value.Type()).EndLine();
+            return true;
+        }
+        return fail("Type mismatch: Expected " + std::string(TokenTypeName(type)) + " but got " + value.Type());
+    }
+
+    binding = Binding{ type, std::move(value) };
+    return true;
+}
+
+// Assignment leaves the value on the stack, it is the result of the expression
+bool VM::executeAssign(Binding& binding, const std::string& name) {
+    const auto& value = stack[sp - 1];
+    const TokenType& expectedType = binding.Type;
+
+    if (expectedType != INT && expectedType != CHAR && expectedType != FLOAT && expectedType != BOOL && expectedType != STRING) {
+        return fail("Error: Unknown Identifier: '" + name + "'");
+    }
+    if (!isTypeCompatible(expectedType, value)) {
+        return fail("Error: Type mismatch for '" + name + "': expected " + std::string(TokenTypeName(expectedType)) + ", got " + value.Type());
+    }
+
+    binding.Value = value;
+    return true;
+}
+
+bool VM::executeScan(Binding& binding) {
+    const TokenType& varType = binding.Type;
+    if (!isScannable(varType)) {
+        return fail("Unsupported type for SCAN: " + std::string(TokenTypeName(varType)));
+    }
+
+    std::string_view input;
+    StandardOutput().Flush(); // Prompts have to be visible before we wait
+    StandardInput().ReadLine(input);
+
+    auto value = scanValue(varType, input);
+    if (value.Is(ObjectType_::ERROR_OBJ)) {
+        return fail(std::move(value));
+    }
+    binding.Value = std::move(value);
+    return true;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "Object.h"
+#include "Compiler.h"
+
+// Stack machine for the bytecode produced by Compiler. Runtime errors are
+// reported the way evalProgram reports them: the message is printed and
+// execution resumes with the next top level statement.
+class VM {
+public:
+    static constexpr size_t StackSize = 2048;
+    static constexpr size_t MaxFrames = 1024;
+
+    explicit VM(const Bytecode& bytecode);
+
+    void Run();
+
+    // Value of the last expression statement, for tests
+    Value LastPoppedStackElem() const;
+
+private:
+    struct Frame {
+        Ref<Closure> Cl;
+        size_t Ip = 0; // Saved here only while another frame runs, or on an error
+        size_t LocalsBase = 0;
+        size_t StackBase = 0;
+    };
+
+    // A local variable. Once a closure captures it, it lives in a Cell the
+    // frame shares with the closure.
+    struct Local {
+        Binding Own;
+        Ref<Cell> Captured;
+
+        Binding& Slot() { return Captured ? Captured->Slot : Own; }
+    };
+
+    std::vector<Value> constants;
+    std::vector<Binding> globals;
+    std::vector<std::string> globalNames;
+    std::vector<size_t> statementStarts;
+
+    // Sized once, calls check that the callee's MaxStack fits before they are made
+    std::vector<Value> stack;
+    size_t sp = 0; // Always points to the next free slot, the top of the stack is stack[sp-1]
+    Value lastPopped;
+
+    std::vector<Local> locals;
+    std::vector<Frame> frames;
+
+    Value error; // What the failed instruction raised, until Run recovers from it
+
+    void push(Value value);
+    Value pop();
+
+    // Each returns false after setting error
+    bool fail(Value raised);
+    bool fail(std::string message);
+    bool executeBinaryOperation(OpCode op);
+    bool executePrefixOperation(OpCode op);
+    bool executeCall(size_t numArgs);
+    bool executeDeclare(Binding& binding, uint8_t typeIndex, DeclareMode mode, const std::string& name);
+    bool executeAssign(Binding& binding, const std::string& name);
+    bool executeScan(Binding& binding);
+    bool pushUnset(const std::string& name);
+
+    void returnFromFrame(Value value);
+    bool recover();
+};
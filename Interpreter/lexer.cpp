@@ -1,17 +1,27 @@
 #include "Lexer.h"
+#include "Scan.h"
+
+#include <algorithm>
 
 Lexer::Lexer(const std::string& input)
-    : input(input), position(0), readPosition(0), ch(0) {
+    : Lexer(std::make_shared<Source>(input)) {}
+
+Lexer::Lexer(SourcePtr source)
+    : Lexer(std::move(source), 0, 1) {}
+
+Lexer::Lexer(SourcePtr source, std::size_t start, uint32_t line)
+    : source(std::move(source)), position(start), readPosition(start), ch(0), line(line) {
+    this->input = this->source->Text();
     readChar(); // Initialize the first character
 }
 
-int Lexer::lexerCurrentLine = 1;
-std::vector<int> Lexer::commentLinePositions;
-
 // Public function definitions
 
 // Reads the next character and advances the position
 void Lexer::readChar() {
+    if (ch == '\n') {
+        ++line;
+    }
     if (readPosition >= input.size()) {
         ch = 0; // Use 0 as EOF marker
     }
@@ -22,9 +32,17 @@ void Lexer::readChar() {
     ++readPosition;
 }
 
+// Moves on to input[newPosition] as readChar would one step at a time. The
+// caller counts any '\n' jumped over.
+void Lexer::skipTo(std::size_t newPosition) {
+    position = newPosition;
+    readPosition = position + 1;
+    ch = newPosition < input.size() ? input[newPosition] : 0;
+}
+
 // Retrieves the next character in advance without incrementing the position (for ==, <>, etc..)
 char Lexer::peekChar() {
-    if (readPosition >= static_cast<int>(input.size())) {
+    if (readPosition >= input.size()) {
         return '\0';
     }
     else {
@@ -37,8 +55,9 @@ Token Lexer::NextToken() {
     Token tok;
 
     skipWhitespace();
+    uint32_t startLine = line;
 
-    std::string stringResult;
+    std::string_view stringResult;
     switch (ch) {
     case '=':
         if (peekChar() == '=') {
@@ -47,23 +66,23 @@ Token Lexer::NextToken() {
             tok.Literal = "==";
         }
         else {
-            tok = { ASSIGN, std::string(1, ch) };
+            tok = { ASSIGN, currentChar() };
         }
         break;
     case '+':
-        tok = { PLUS, std::string(1, ch) };
+        tok = { PLUS, currentChar() };
         break;
     case '-':
-        tok = { MINUS, std::string(1, ch) };
+        tok = { MINUS, currentChar() };
         break;
     case '*':
-        tok = { ASTERISK, std::string(1, ch) };
+        tok = { ASTERISK, currentChar() };
         break;
     case '/':
-        tok = { SLASH, std::string(1, ch) };
+        tok = { SLASH, currentChar() };
         break;
     case '!':
-        tok = { BANG, std::string(1, ch) };
+        tok = { BANG, currentChar() };
         break;
     case '<':
         if (peekChar() == '>') {
@@ -77,7 +96,7 @@ Token Lexer::NextToken() {
             tok.Literal = "<=";
         }
         else {
-            tok = { LT, std::string(1, ch) };
+            tok = { LT, currentChar() };
         }
         break;
     case '>':
@@ -87,29 +106,29 @@ Token Lexer::NextToken() {
             tok.Literal = ">=";
         }
         else {
-            tok = { GT, std::string(1, ch) };
+            tok = { GT, currentChar() };
         }
         break;
     case ',':
-        tok = { COMMA, std::string(1, ch) };
+        tok = { COMMA, currentChar() };
         break;
     case ':':
-        tok = { COLON, std::string(1, ch) };
+        tok = { COLON, currentChar() };
         break;
     case ';':
-        tok = { SEMICOLON, std::string(1, ch) };
+        tok = { SEMICOLON, currentChar() };
         break;
     case '(':
-        tok = { LPAREN, std::string(1, ch) };
+        tok = { LPAREN, currentChar() };
         break;
     case ')':
-        tok = { RPAREN, std::string(1, ch) };
+        tok = { RPAREN, currentChar() };
         break;
     case '{':
-        tok = { LBRACE, std::string(1, ch) };
+        tok = { LBRACE, currentChar() };
         break;
     case '}':
-        tok = { RBRACE, std::string(1, ch) };
+        tok = { RBRACE, currentChar() };
         break;
     case '[': // HERE
         tok.Literal = escapeString();
@@ -117,13 +136,10 @@ Token Lexer::NextToken() {
         break;
     case '#':
         skipComment();
-        if (ch == '\n') {
-            lexerCurrentLine++;
-        }
-        tok = { NEWLINE, std::string(1, ch) };
+        tok = { NEWLINE, currentChar() };
         break;
     case '.':
-        tok = { DOT, std::string(1, ch) };
+        tok = { DOT, currentChar() };
         break;
     case '\'':
         tok = {
@@ -160,11 +176,10 @@ Token Lexer::NextToken() {
         };
         break;
     case '&':
-        tok = { AMPERSAND, std::string(1, ch) };
+        tok = { AMPERSAND, currentChar() };
         break;
     case '\n':
-        lexerCurrentLine++;
-        tok = { NEWLINE, std::string(1, ch) };
+        tok = { NEWLINE, currentChar() };
         break;
     case 0: // End of file / input
         tok.Type = EOF_TOKEN;
@@ -174,113 +189,119 @@ Token Lexer::NextToken() {
         if (isLetter(ch)) {
             tok.Literal = readIdentifier();
             tok.Type = lookupIdent(tok.Literal); // Determine if it's a keyword or just an IDENT
+            tok.Line = startLine;
             return tok;
         }
         else if (isDigit(ch)) {
             tok.Literal = readNumber();
             tok.Type = NUM; 
+            tok.Line = startLine;
             return tok;
         }
         else {
-            tok = { ILLEGAL, std::string(1, ch) };
+            tok = { ILLEGAL, currentChar() };
         }
         break;
     }
+    tok.Line = startLine;
     readChar(); // Move to the next character
     return tok;
 }
 
 // Private function definitions
 
+std::string_view Lexer::currentChar() const {
+    if (position >= input.size()) {
+        return {};
+    }
+    return input.substr(position, 1);
+}
+
 // Check if keyword or identifier
-std::string Lexer::readIdentifier() {
-    int startPosition = position;
+std::string_view Lexer::readIdentifier() {
+    std::size_t startPosition = position;
 
     // Verify if the first index is a letter
     if (isLetter(ch)) {
-        readChar();
+        skipTo(ScanIdentifier(input, position + 1));
     }
 
-    // Continue reading
-    while (isLetter(ch) || isDigit(ch)) {
-        readChar();
-    }
-
-    return std::string(input.substr(startPosition, position - startPosition));
+    return input.substr(startPosition, position - startPosition);
 }
 
-// Skips whitespace in code
+// Skips whitespace in code. A '\r' goes too, so "\r\n" from a Windows checkout
+// comes out as one NEWLINE.
 void Lexer::skipWhitespace() {
-    while (ch == ' ' 
+    if (ch == ' ' 
         || ch == '\t' 
-        //|| ch == '\n' 
-        //|| ch == '\r' // Commented out to treat newlines as a token by the Lexer
+        || ch == '\r'
+        //|| ch == '\n' // Commented out to treat newlines as a token by the Lexer
     ) {
-        readChar();
+        skipTo(ScanSpaces(input, position + 1));
     }
 }
 
 // Distinguishes between keywords and identifiers
-TokenType Lexer::lookupIdent(const std::string& ident) { 
-    auto it = keywords.find(ident);
-    if (it != keywords.end()) {
-        return it->second;
-    }
-    return IDENT;
+TokenType Lexer::lookupIdent(std::string_view ident) { 
+    return Keywords.Lookup(ident);
 }
 
 // Check if number
-std::string Lexer::readNumber() {
-    int startPosition = position;
-    while (isDigit(ch)) {
-        readChar();
+std::string_view Lexer::readNumber() {
+    std::size_t startPosition = position;
+    if (isDigit(ch)) {
+        skipTo(ScanDigits(input, position + 1));
     }
-    // Since input is a std::string_view, we directly return a std::string part of it
-    return std::string(input.substr(startPosition, position - startPosition));
+    return input.substr(startPosition, position - startPosition);
 }
 
 // Read strings
-std::string Lexer::readString() {
-    std::string str;
-    int startPosition = position + 1;
+std::string_view Lexer::readString() {
+    std::size_t startPosition = position + 1;
+    std::size_t end = ScanString(input, startPosition);
+    line += static_cast<uint32_t>(std::count(input.begin() + startPosition, input.begin() + end, '\n'));
+    skipTo(end);
+    if (ch != '[') {
+        return input.substr(startPosition, position - startPosition);
+    }
+
+    // Has escapes, the literal has to be built
+
+    std::string str(input.substr(startPosition, position - startPosition));
     while (true) {
-        readChar();
         if (ch == '[') {
             str += escapeString();
+            readChar();
             continue;
         }
         if (ch == '"' || ch == 0) {
             break;
         }
         str += ch;
+        readChar();
     }
-    return str;
+    return source->Intern(std::move(str));
 }
 
 // Read char
-std::string Lexer::readCharString() {
-    std::string str;
-    int startPosition = position + 1;
+std::string_view Lexer::readCharString() {
+    std::size_t startPosition = position + 1;
     while (true) {
         readChar();
         if (ch == '\'' || ch == 0) {
             break;
         }
-        str += ch;
     }
-    return str;
+    return input.substr(startPosition, position - startPosition);
 }
 
 void Lexer::skipComment() {
-    while (ch != '\n' && ch != 0) {
-        readChar();  
-    }
-    commentLinePositions.push_back(lexerCurrentLine);
+    skipTo(ScanLine(input, position));
     //readChar();
 }
 
-std::string Lexer::escapeString() {
-    int startPosition = position + 1;
+std::string_view Lexer::escapeString() {
+    std::size_t startPosition = position + 1;
     while (true) {
         readChar();
         if (ch == ']' || ch == 0) {
@@ -288,7 +309,7 @@ std::string Lexer::escapeString() {
         }
     }
 
-    std::string substring = input.substr(startPosition, position - startPosition);
+    std::string_view substring = input.substr(startPosition, position - startPosition);
 
     if (substring == "NEWLINE") {
         return "\n";
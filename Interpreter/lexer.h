@@ -2,34 +2,48 @@
 #include <string>
 #include <iostream>
 #include "Token.h"
+#include "Source.h"
 
 
 class Lexer {
 public:
-    static int lexerCurrentLine;
-    static std::vector<int> commentLinePositions;
-
     Lexer(const std::string& input); 
+    explicit Lexer(SourcePtr source);
+
+    // Starts partway through the source, at an offset where a token may begin,
+    // with line being the line number there
+    Lexer(SourcePtr source, std::size_t start, uint32_t line);
 
     void readChar(); // Reads the next character and advances the position
     char peekChar(); // Retrieves the next character in advance without incrementing the position (for ==, <>, etc..)
     Token NextToken(); // Tokenizer
 
+    // The buffer the token literals point into
+    const SourcePtr& GetSource() const { return source; }
+
+    // Where the next token will be looked for, and its line
+    std::size_t Position() const { return position; }
+    uint32_t Line() const { return line; }
+
 
 private:
-    std::string input; // Input string being parsed
-    int position;      // Current position in input (points to current char)
-    int readPosition;  // Current reading position in input (after current char)
-    char ch;           // Current char under examination
-
-    std::string readIdentifier(); // Check if keyword or identifier
-    std::string readNumber(); // Check if number
-    std::string readString(); // Read strings
-    std::string readCharString(); // Read char 
+    SourcePtr source;       // Owns the text, shared with the AST
+    std::string_view input; // Input string being parsed
+    std::size_t position;     // Current position in input (points to current char)
+    std::size_t readPosition; // Current reading position in input (after current char)
+    char ch;                  // Current char under examination
+    uint32_t line = 1;        // Line of ch, counted as readChar moves past each '\n'
+
+    std::string_view readIdentifier(); // Check if keyword or identifier
+    std::string_view readNumber(); // Check if number
+    std::string_view readString(); // Read strings
+    std::string_view readCharString(); // Read char 
+    void skipTo(std::size_t newPosition); // Jumps over a run found by one of the Scan functions
     void skipComment();
     void skipWhitespace(); // Skips whitespace in code
-    std::string escapeString(); // Escape string syntax
-    TokenType lookupIdent(const std::string& ident); // Distinguishes between keywords and identifiers
+    std::string_view escapeString(); // Escape string syntax
+    std::string_view currentChar() const; // The character under examination, as a view into the input
+    TokenType lookupIdent(std::string_view ident); // Distinguishes between keywords and identifiers
 
     static bool isLetter(char ch) {
         return std::isalpha(ch)
@@ -1,6 +1,9 @@
 #include <iostream>
 #include "Tests.h"
 #include "Repl.h"
+#include "Compiler.h"
+#include "VM.h"
+#include "Tracer.h"
 #include <string.h>
 #include <fstream>
 #include <sstream>
@@ -8,6 +11,7 @@
 #include <string>
 #include <cstring>
 #include <memory>
+#include <stdexcept>
 
 static void displayHelp() {
     // TODO(hans): Print more help
@@ -27,6 +31,12 @@ static void displayHelp() {
         std::cout << " Usage: code <filename|flags> " << std::endl;
         std::cout << " -h | --help : Display help" << std::endl;
         std::cout << " -v | --verbose : Display verbose" << std::endl;
+        std::cout << " -  : Read the program from stdin" << std::endl;
+        std::cout << " --engine=eval|vm : Run with the tree-walking evaluator (default) or the bytecode VM" << std::endl;
+        std::cout << " --flush=line|block|none : When DISPLAY output is written out (default: line on a terminal, block otherwise)" << std::endl;
+        std::cout << " --gc-stats : Report garbage collections and their pauses on stderr at exit" << std::endl;
+        std::cout << " --trace-parse : Dump the parser's timed call trace to stderr (debug builds)" << std::endl;
+        std::cout << " --lex-threads=N : Threads for lexing files over 4 MB (default: one per core, 1 lexes on the main thread)" << std::endl;
         done = true;
     }
 }
@@ -40,17 +50,18 @@ static void displayVerbose() {
     }
 }
 
-std::string readFile(const std::string& filePath) {
-    std::ifstream fileStream(filePath);
-    if (!fileStream.is_open()) {
-        std::cerr << "Could not open file: " << filePath << std::endl;
-        return "";
+SourcePtr readFile(const std::string& filePath) {
+    try {
+        auto source = Source::Load(filePath);
+        if (!source) {
+            std::cerr << "Could not open file: " << filePath << std::endl;
+        }
+        return source;
+    }
+    catch (const std::length_error& e) {
+        std::cerr << "File too large: " << filePath << ": " << e.what() << std::endl;
+        return nullptr;
     }
-
-    std::stringstream buffer;
-    buffer << fileStream.rdbuf();
-    fileStream.close();
-    return buffer.str();
 }
 
 
@@ -58,6 +69,9 @@ std::string readFile(const std::string& filePath) {
 int main(int argc, char* argv[]) {
 
     std::vector<std::string> files;
+    bool useVM = false;
+    bool gcStats = false;
+    unsigned int lexThreads = 0;
 
     //bool testMode = true;
     bool testMode = false;
@@ -68,7 +82,7 @@ int main(int argc, char* argv[]) {
     else {
         // Process command arguments
         for (int i = 1; i < argc; i++) {
-            if (argv[i][0] == '-') { // Compiler flag
+            if (argv[i][0] == '-' && argv[i][1] != '\0') { // Compiler flag ("-" alone reads the program from stdin)
                 // Help flag
                 if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
                     displayHelp();
@@ -77,6 +91,38 @@ int main(int argc, char* argv[]) {
                 if (!strcmp(argv[i], "-v") || !strcmp(argv[i], "--verbose")) {
                     displayVerbose();
                 }
+                // Execution engine
+                if (!strcmp(argv[i], "--engine=vm")) {
+                    useVM = true;
+                }
+                else if (!strcmp(argv[i], "--engine=eval")) {
+                    useVM = false;
+                }
+                else if (!strncmp(argv[i], "--engine=", 9)) {
+                    std::cerr << "Unknown engine: " << (argv[i] + 9) << std::endl;
+                    return EXIT_FAILURE;
+                }
+                // Output buffering
+                if (!strncmp(argv[i], "--flush=", 8)) {
+                    FlushPolicy policy;
+                    if (!Output::ParsePolicy(argv[i] + 8, policy)) {
+                        std::cerr << "Unknown flush policy: " << (argv[i] + 8) << std::endl;
+                        return EXIT_FAILURE;
+                    }
+                    StandardOutput().SetPolicy(policy);
+                }
+                // Memory report
+                if (!strcmp(argv[i], "--gc-stats")) {
+                    gcStats = true;
+                }
+                // Parser tracing
+                if (!strcmp(argv[i], "--trace-parse")) {
+                    Tracer::SetEnabled(true);
+                }
+                // Parallel lexing
+                if (!strncmp(argv[i], "--lex-threads=", 14)) {
+                    lexThreads = static_cast<unsigned int>(std::max(0, atoi(argv[i] + 14)));
+                }
             } else { // File input
                 // NOTE(hans): Assume only one file for now
                 files.push_back(std::string(argv[i]));
@@ -94,16 +140,19 @@ int main(int argc, char* argv[]) {
             Repl repl;
             repl.Start(std::cin, std::cout);
         } else { // Input files specified interpret source code
-            std::string fileContent = readFile(files[0]);
-            if (!fileContent.empty()) {
-                //std::cout << "File content:\n" << fileContent << std::endl;
-                auto lexer = std::make_unique<Lexer>(fileContent);
-                Parser parser(std::move(lexer));
+            auto fileContent = readFile(files[0]);
+            if (fileContent && !fileContent->Text().empty()) {
+                //std::cout << "File content:\n" << fileContent->Text() << std::endl;
+                Parser parser(TokenStream::LexParallel(fileContent, TokenStream::DefaultChunkSize, lexThreads));
 
                 auto program = parser.ParseProgram();
+                if (Tracer::trace) {
+                    Tracer::Dump(std::cerr);
+                }
                 //parser.enforcedStructure = false;
                 // Enforce Structure
                 if (parser.enforcedStructure) {
+                    ParseState mainstate = ParseState::BeginCode;
                     for (const auto& stmt : program->Statements) {
                         if (mainstate == ParseState::BeginCode) {
                             if (!isBeginCodeStatement(stmt)) {
@@ -115,7 +164,7 @@ int main(int argc, char* argv[]) {
 
                         else if (mainstate == ParseState::FunctionDeclarations) {
                             auto expr = extractExpression(stmt);
-                            const auto fnlit = dynamic_cast<FunctionLiteral*>(expr.get());
+                            const auto fnlit = expr ? expr->As<FunctionLiteral>() : nullptr;
                             if (fnlit) {
                                 // Pass
                             }
@@ -136,13 +185,13 @@ int main(int argc, char* argv[]) {
 
                         else if (mainstate == ParseState::VariableDeclarations) {
                             bool transitionFlag = false;
-                            if (auto exprstmt = dynamic_cast<ExpressionStatement*>(stmt.get())) {
+                            if (auto exprstmt = stmt->As<ExpressionStatement>()) {
                                 //std::cout << exprstmt->TokenLiteral() << std::endl;
                                 if (exprstmt->TokenLiteral() == "FUNCTION") {
                                     transitionFlag = true;
                                 }
                             }
-                            if (auto typedDeclStmt = dynamic_cast<TypedDeclStatement*>(stmt.get())) {
+                            if (stmt->As<TypedDeclStatement>()) {
                                 // Pass
                             }
                             else if (isTransitionToExecutableCode(stmt)) {
@@ -161,13 +210,13 @@ int main(int argc, char* argv[]) {
 
                         else if (mainstate == ParseState::ExecutableCode) {
                             auto expr = extractExpression(stmt);
-                            const auto fnlit = dynamic_cast<FunctionLiteral*>(expr.get());
+                            const auto fnlit = expr ? expr->As<FunctionLiteral>() : nullptr;
                             if (fnlit) {
                                 std::cerr << "Structure Error: Unexpected function declaration in Executable Code state." << std::endl;
                                 //std::exit(EXIT_FAILURE);
                             }
 
-                            else if (auto typedDeclStmt = dynamic_cast<TypedDeclStatement*>(stmt.get())) {
+                            else if (stmt->As<TypedDeclStatement>()) {
                                 std::cerr << "Structure Error: Unexpected variable declaration in Executable Code state." << std::endl;
                                 //std::exit(EXIT_FAILURE);
                             }
@@ -198,13 +247,39 @@ int main(int argc, char* argv[]) {
                 /* if (!enforceProgramStructure(clonedStatements)) {
                     std::exit(EXIT_FAILURE);
                 }*/
-                auto env = std::make_shared<Environment>();
+                if (useVM) {
+                    Compiler compiler;
+                    if (!compiler.Compile(program.get())) {
+                        for (const auto& error : compiler.Errors()) {
+                            std::cout << error << std::endl;
+                        }
+                        return EXIT_FAILURE;
+                    }
 
-                auto res = Eval(program.get(), env);
+                    VM vm(compiler.GetBytecode());
+                    vm.Run();
+                    if (gcStats) {
+                        DefaultCollector().PrintStats(std::cerr);
+                    }
+                    return 0;
+                }
+
+                {
+                    auto env = MakeRef<Environment>();
+                    Resolver(*env).Resolve(program.get());
+
+                    auto res = Eval(program.get(), env);
+
+                    // Display if any evaluation errors
+                    if (auto displayObject = res.As<ErrorObject>()) {
+                        StandardOutput().Write(displayObject->Message).EndLine();
+                    }
+                }
 
-                // Display if any evaluation errors
-                if (auto displayObject = dynamic_cast<ErrorObject*>(res.get())) {
-                    std::cout << displayObject->Message << std::endl;
+                // The globals and the FUNCTIONs declared in them hold each other
+                DefaultCollector().Collect();
+                if (gcStats) {
+                    DefaultCollector().PrintStats(std::cerr);
                 }
             }
         }
@@ -1,25 +1,25 @@
 #include "evaluator_test.h"
 
 
-static std::shared_ptr<Object> testEval(const std::string& input) {
+static Value testEval(const std::string& input) {
     auto lexer = std::make_unique<Lexer>(input);
     Parser parser(std::move(lexer));
     
     auto program = parser.ParseProgram();
-    auto env = std::make_shared<Environment>();
+    auto env = MakeRef<Environment>();
+    Resolver(*env).Resolve(program.get());
 
     return Eval(program.get(), env);
 }
 
-static bool testIntegerObject(const std::shared_ptr<Object>& obj, int64_t expected) {
-    auto result = dynamic_cast<IntegerObject*>(obj.get());
-    if (!result) {
-        std::cerr << "object is not Integer. got=" << typeid(*obj).name() << std::endl;
+static bool testIntegerObject(const Value& obj, int64_t expected) {
+    if (!obj.IsInteger()) {
+        std::cerr << "object is not Integer. got=" << obj.Type() << std::endl;
         return false;
     }
 
-    if (result->Value != expected) {
-        std::cerr << "object has wrong value. got=" << result->Value << ", want=" << expected << std::endl;
+    if (obj.AsInteger() != expected) {
+        std::cerr << "object has wrong value. got=" << obj.AsInteger() << ", want=" << expected << std::endl;
         return false;
     }
 
@@ -61,15 +61,14 @@ void TestEvalNumericalExpression() {
     std::cout << "TestEvalNumericalExpression passed." << std::endl;
 }
 
-static bool testBooleanObject(const std::shared_ptr<Object>& obj, bool expected) {
-    auto result = dynamic_cast<BooleanObject*>(obj.get());
-    if (!result) {
-        std::cout << "object is not Boolean. got=" << typeid(*obj).name() << std::endl;
+static bool testBooleanObject(const Value& obj, bool expected) {
+    if (!obj.IsBoolean()) {
+        std::cout << "object is not Boolean. got=" << obj.Type() << std::endl;
         return false;
     }
 
-    if (result->Value != expected) {
-        std::cout << "object has wrong value. got=" << std::boolalpha << result->Value << ", want=" << expected << std::endl;
+    if (obj.AsBoolean() != expected) {
+        std::cout << "object has wrong value. got=" << std::boolalpha << obj.AsBoolean() << ", want=" << expected << std::endl;
         return false;
     }
 
@@ -151,9 +150,9 @@ void TestBangOperator() {
     std::cout << "TestBangOperator passed." << std::endl;
 }
 
-static bool testNullObject(const std::shared_ptr<Object>& obj) {
-    if (dynamic_cast<NullObject*>(obj.get()) == nullptr) {
-        std::cerr << "Object is not a NullObject. got = " << typeid(*obj).name() << std::endl;
+static bool testNullObject(const Value& obj) {
+    if (!obj.IsNull()) {
+        std::cerr << "Object is not a NullObject. got = " << obj.Type() << std::endl;
         return false;
     }
     return true;
@@ -272,7 +271,7 @@ IF (10 > 1)
     std::cout << "TestReturnStatements passed." << std::endl;
 }
 
-std::shared_ptr<Object> testEval(const std::string& input);
+Value testEval(const std::string& input);
 
 void TestErrorHandling() {
     struct TestCase {
@@ -315,9 +314,9 @@ void TestErrorHandling() {
     for (const auto& tt : tests) {
         auto evaluated = testEval(tt.input);
 
-        auto errObj = dynamic_cast<ErrorObject*>(evaluated.get());
+        auto errObj = evaluated.As<ErrorObject>();
         if (!errObj) {
-            std::cerr << "no error object returned. got=" << typeid(*evaluated).name() << std::endl;
+            std::cerr << "no error object returned. got=" << evaluated.Type() << std::endl;
             std::exit(EXIT_FAILURE);
         }
 
@@ -368,15 +367,14 @@ void TestTypedDeclStatementsV2() {
     }
 }
 
-static bool testFloatObject(const std::shared_ptr<Object>& obj, double expected) {
-    auto result = dynamic_cast<FloatObject*>(obj.get());
-    if (!result) {
-        std::cerr << "object is not Float. got=" << typeid(*obj).name() << std::endl;
+static bool testFloatObject(const Value& obj, double expected) {
+    if (!obj.IsFloat()) {
+        std::cerr << "object is not Float. got=" << obj.Type() << std::endl;
         return false;
     }
 
-    if (result->Value != expected) {
-        std::cerr << "object has wrong value. got=" << result->Value << ", want=" << expected << std::endl;
+    if (obj.AsFloat() != expected) {
+        std::cerr << "object has wrong value. got=" << obj.AsFloat() << ", want=" << expected << std::endl;
         return false;
     }
 
@@ -426,8 +424,8 @@ void TestFunctionObject() {
                             x + 2
                             END FUNCTION)";
 
-    auto evaluated = testEval(input); // Assuming testEval returns std::shared_ptr<Object>
-    Function* fn = dynamic_cast<Function*>(evaluated.get());
+    auto evaluated = testEval(input); // Assuming testEval returns a Value
+    Function* fn = evaluated.As<Function>();
 
     if (!fn) {
         std::cerr << "TestFunctionObject failed: object is not Function." << std::endl;
@@ -511,7 +509,7 @@ void TestFunctionApplication() {
 
     for (const auto& test : tests) {
         auto evaluated = testEval(test.input);
-        std::cout << "Evaluated: " << evaluated->Inspect() << std::endl;
+        std::cout << "Evaluated: " << evaluated.Inspect() << std::endl;
         if (!testIntegerObject(evaluated, test.expected)) {
             std::cerr << "Test failed for input: " << test.input << std::endl;
             std::exit(EXIT_FAILURE);
@@ -539,7 +537,7 @@ void TestClosures() {
 )";
 
     auto evaluated = testEval(input);
-    std::cout << "Evaluation: \n" << evaluated->Inspect() << std::endl;
+    std::cout << "Evaluation: \n" << evaluated.Inspect() << std::endl;
     testIntegerObject(evaluated, 4);
 
     std::cout << "TestClosures passed." << std::endl;
@@ -550,9 +548,9 @@ void TestStringLiteral() {
 
     auto evaluated = testEval(input);
 
-    auto str = dynamic_cast<String*>(evaluated.get());
+    auto str = evaluated.As<String>();
     if (!str) {
-        std::cerr << "Object is not String. Got=" << typeid(*evaluated).name() << std::endl;
+        std::cerr << "Object is not String. Got=" << evaluated.Type() << std::endl;
         std::exit(EXIT_FAILURE);
     }
 
@@ -569,9 +567,9 @@ void TestStringConcatenation() {
 
     auto evaluated = testEval(input);
 
-    auto str = dynamic_cast<String*>(evaluated.get());
+    auto str = evaluated.As<String>();
     if (!str) {
-        std::cerr << "Object is not String. Got=" << typeid(*evaluated).name() << std::endl;
+        std::cerr << "Object is not String. Got=" << evaluated.Type() << std::endl;
         std::exit(EXIT_FAILURE);
     }
 
@@ -588,14 +586,13 @@ void TestCharLiteral() {
 
     auto evaluated = testEval(input);
 
-    auto chr = dynamic_cast<Char*>(evaluated.get());
-    if (!chr) {
-        std::cerr << "Object is not Char. Got=" << typeid(*evaluated).name() << std::endl;
+    if (!evaluated.IsChar()) {
+        std::cerr << "Object is not Char. Got=" << evaluated.Type() << std::endl;
         std::exit(EXIT_FAILURE);
     }
 
-    if (chr->Value != 'a') {
-        std::cerr << "Char has wrong value. Got=\"" << chr->Value << "\"" << std::endl;
+    if (evaluated.AsChar() != 'a') {
+        std::cerr << "Char has wrong value. Got=\"" << evaluated.AsChar() << "\"" << std::endl;
         std::exit(EXIT_FAILURE);
     }
 
@@ -677,13 +674,13 @@ void TestBuiltinFunctions() {
                 }
             }
             else if constexpr (std::is_same_v<T, std::string>) {
-                if (auto errObj = dynamic_cast<ErrorObject*>(evaluated.get())) {
+                if (auto errObj = evaluated.As<ErrorObject>()) {
                     if (!errObj || errObj->Message != expected) {
                         std::cerr << "Test failed for input: " << test.input << ". Expected error: " << expected << ", got: " << (errObj ? errObj->Message : "not an error") << std::endl;
                         std::exit(EXIT_FAILURE);
                     }
                 }
-                else if (auto str = dynamic_cast<String*>(evaluated.get())) {
+                else if (auto str = evaluated.As<String>()) {
                     if (!str || str->Value != expected) {
                         std::cerr << "Test failed for input: " << test.input << ". Expected msg: " << expected << ", got: " << (str ? str->Value : "not an string") << std::endl;
                         std::exit(EXIT_FAILURE);
@@ -696,3 +693,162 @@ void TestBuiltinFunctions() {
 
     std::cout << "TestBuiltinFunctions passed." << std::endl;
 }
+
+void TestGarbageCollection() {
+    std::string input = R"(
+    INT n = 2
+    FUNCTION twice() INT:
+    BEGIN FUNCTION
+        RETURN n * 2
+    END FUNCTION
+    FUNCTION square() INT:
+    BEGIN FUNCTION
+        RETURN n * n
+    END FUNCTION
+    twice:
+)";
+
+    DefaultCollector().Collect(); // Leftovers of earlier tests
+
+    // The globals hold both FUNCTIONs and each FUNCTION holds the globals, so
+    // nothing is freed when testEval drops the environment
+    auto evaluated = testEval(input);
+    if (!testIntegerObject(evaluated, 4)) {
+        std::exit(EXIT_FAILURE);
+    }
+
+    std::size_t freed = DefaultCollector().Collect();
+    if (freed != 3) {
+        std::cerr << "collection freed " << freed << " objects, want 3" << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+    if (DefaultCollector().Collect() != 0) {
+        std::cerr << "second collection found more garbage" << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+
+    std::cout << "TestGarbageCollection passed." << std::endl;
+}
+
+void TestConcurrentPrograms() {
+    // Each program reads its own n, so mixed up input or output shows
+    std::string input = R"(
+    INT n
+    SCAN: n
+    INT total = 0
+    FUNCTION doubled() INT:
+    BEGIN FUNCTION
+        RETURN total * 2
+    END FUNCTION
+    INT i = 0
+    WHILE (i < 1000)
+    BEGIN WHILE
+        total = total + n
+        i = i + 1
+    END WHILE
+    DISPLAY: total
+    doubled:
+)";
+
+    constexpr int programs = 4;
+    std::vector<std::string> failures(programs);
+    std::vector<std::thread> threads;
+    for (int id = 0; id < programs; id++) {
+        threads.emplace_back([&, id] {
+            int n = id + 1;
+            std::FILE* inFile = std::tmpfile();
+            std::FILE* outFile = std::tmpfile();
+            std::fprintf(inFile, "%d\n", n);
+            std::fflush(inFile);
+            std::rewind(inFile);
+
+            {
+                Output out(outFile, FlushPolicy::Block);
+                Input in(fileno(inFile), true);
+                Runtime runtime(out, in);
+                RuntimeScope scope(runtime);
+
+                auto evaluated = testEval(input);
+                if (!evaluated.IsInteger() || evaluated.AsInteger() != 2000 * n) {
+                    failures[id] = "result " + evaluated.Inspect() + ", want " + std::to_string(2000 * n);
+                }
+                else if (std::size_t freed = runtime.Gc.Collect(); freed != 2) {
+                    failures[id] = "collection freed " + std::to_string(freed) + " objects, want 2";
+                }
+                out.Flush();
+            }
+
+            char written[64] = {};
+            std::rewind(outFile);
+            std::size_t size = std::fread(written, 1, sizeof(written) - 1, outFile);
+            std::string expected = std::to_string(1000 * n) + "\n";
+            if (failures[id].empty() && std::string(written, size) != expected) {
+                failures[id] = "wrote '" + std::string(written, size) + "', want '" + expected + "'";
+            }
+            std::fclose(inFile);
+            std::fclose(outFile);
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    for (int id = 0; id < programs; id++) {
+        if (!failures[id].empty()) {
+            std::cerr << "program " << id << ": " << failures[id] << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+    }
+
+    std::cout << "TestConcurrentPrograms passed." << std::endl;
+}
+
+void TestErrorLines() {
+    struct TestCase {
+        std::string input;
+        uint32_t expectedLine;
+    };
+
+    std::vector<TestCase> tests = {
+        {R"(5 + "TRUE")", 1},
+        {R"(5
+            # comment
+            "TRUE" + "FALSE")", 3},
+        // Only the third iteration fails
+        {R"(INT i = 0
+            WHILE (i < 5)
+            BEGIN WHILE
+                i = i + 1
+                IF (i == 3)
+                BEGIN IF
+                    i + "TRUE"
+                END IF
+            END WHILE)", 7},
+        // Reported where the body failed, not where it was called
+        {R"(INT n = 2
+            FUNCTION broken() INT:
+            BEGIN FUNCTION
+                RETURN n + "TRUE"
+            END FUNCTION
+            broken:)", 4},
+    };
+
+    for (const auto& tt : tests) {
+        auto evaluated = testEval(tt.input);
+
+        auto errObj = evaluated.As<ErrorObject>();
+        if (!errObj) {
+            std::cerr << "no error object returned. got=" << evaluated.Type() << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+
+        if (errObj->Line != tt.expectedLine) {
+            std::cerr << "wrong error line. expected=" << tt.expectedLine << ", got=" << errObj->Line << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+
+        std::cout << "Test passed for input: " << tt.input << std::endl;
+    }
+
+    std::cout << "TestErrorLines passed." << std::endl;
+}
@@ -12,6 +12,8 @@
 #include <optional>
 #include <cassert>
 #include <variant>
+#include <thread>
+#include <cstdio>
 
 void TestEvalNumericalExpression();
 void TestEvalBooleanExpression();
@@ -27,4 +29,7 @@ void TestClosures();
 void TestStringLiteral();
 void TestStringConcatenation();
 void TestCharLiteral();
-void TestBuiltinFunctions();
\ No newline at end of file
+void TestBuiltinFunctions();
+void TestGarbageCollection();
+void TestConcurrentPrograms();
+void TestErrorLines();
\ No newline at end of file
@@ -2,6 +2,8 @@
 #include <vector>
 #include "Lexer_test.h"
 #include "../Lexer.h"
+#include "../Scan.h"
+#include "../TokenStream.h"
 
 static void assertEqual(const TokenType& actual, const TokenType& expected, const std::string& message) {
     if (actual != expected) {
@@ -11,6 +13,22 @@ static void assertEqual(const TokenType& actual, const TokenType& expected, cons
     }
 }
 
+static void assertEqual(std::size_t actual, std::size_t expected, const std::string& message) {
+    if (actual != expected) {
+        std::cerr << " Assertion failed: " << message << "\n"
+            << "Expected: " << expected << ", Actual: " << actual << std::endl;
+        std::exit(EXIT_FAILURE); // Exit the program with a failure status
+    }
+}
+
+static void assertEqual(std::string_view actual, std::string_view expected, const std::string& message) {
+    if (actual != expected) {
+        std::cerr << " Assertion failed: " << message << "\n"
+            << "Expected: " << expected << ", Actual: " << actual << std::endl;
+        std::exit(EXIT_FAILURE); // Exit the program with a failure status
+    }
+}
+
 void TestNextToken() {
     std::string input = 
 R"(=+(){},;
@@ -263,3 +281,202 @@ void TestNextToken3() {
 
     std::cout << "All tests passed!" << std::endl;
 }
+
+void TestKeywords() {
+    std::string input = R"(FUNCTION BEGIN END CODE IF ELSE RETURN WHILE INT CHAR BOOL FLOAT STRING VOID
+IFF INTEGER If BEGINS FN END_ CODES VOIDS E F ELSEIF ENDIF Int)";
+    Lexer l(input);
+
+    std::vector<std::pair<TokenType, std::string>> tests = {
+        {FUNCTION, "FUNCTION"},
+        {BEGIN, "BEGIN"},
+        {END, "END"},
+        {CODE, "CODE"},
+        {IF, "IF"},
+        {ELSE, "ELSE"},
+        {RETURN, "RETURN"},
+        {WHILE, "WHILE"},
+        {INT, "INT"},
+        {CHAR, "CHAR"},
+        {BOOL, "BOOL"},
+        {FLOAT, "FLOAT"},
+        {STRING, "STRING"},
+        {VOID, "VOID"},
+        {NEWLINE, "\n"},
+        // Near misses are identifiers
+        {IDENT, "IFF"},
+        {IDENT, "INTEGER"},
+        {IDENT, "If"},
+        {IDENT, "BEGINS"},
+        {IDENT, "FN"},
+        {IDENT, "END_"},
+        {IDENT, "CODES"},
+        {IDENT, "VOIDS"},
+        {IDENT, "E"},
+        {IDENT, "F"},
+        {IDENT, "ELSEIF"},
+        {IDENT, "ENDIF"},
+        {IDENT, "Int"},
+        {EOF_TOKEN, ""},
+    };
+
+    for (size_t i = 0; i < tests.size(); ++i) {
+        Token tok = l.NextToken();
+        std::cout << "Testing token: " << tok.Literal << " ";
+        assertEqual(tok.Type, tests[i].first, "Test[" + std::to_string(i) + "] - TokenType wrong.");
+        assertEqual(tok.Literal, tests[i].second, "Test[" + std::to_string(i) + "] - Literal wrong.");
+        std::cout << "Test passed!" << std::endl;
+    }
+
+    std::cout << "All tests passed!" << std::endl;
+}
+
+// Every scanning kernel the processor supports has to find the same run ends
+// as a byte-at-a-time loop, wherever the run ends within or across blocks
+void TestScanKernels() {
+    // Bytes at the edges of the classes the kernels test for
+    const std::string alphabet = std::string("azAZ09_ \t\n\"[") + '\0' + "@`{/:]\x7f\x80\xff";
+
+    auto reference = [](std::string_view text, std::size_t from, auto inRun) {
+        while (from < text.size() && inRun(static_cast<unsigned char>(text[from]))) {
+            ++from;
+        }
+        return from;
+    };
+    auto isLetterOrDigit = [](unsigned char c) {
+        return ('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') || ('0' <= c && c <= '9') || c == '_';
+    };
+
+    ScanKernel original = CurrentScanKernel();
+    uint32_t seed = 12345;
+    for (ScanKernel kernel : { ScanKernel::Scalar, ScanKernel::Sse2, ScanKernel::Avx2 }) {
+        if (!SetScanKernel(kernel)) {
+            std::cout << "Skipping " << ScanKernelName(kernel) << ", not supported" << std::endl;
+            continue;
+        }
+
+        for (int round = 0; round < 2000; ++round) {
+            // A run of one class followed by a random tail, so the ends fall everywhere
+            std::size_t length = round % 100;
+            std::string text;
+            char fill = alphabet[round % alphabet.size()];
+            for (std::size_t i = 0; i < length; ++i) {
+                seed = seed * 1103515245 + 12345;
+                text += (seed >> 16) % 8 == 0 ? alphabet[(seed >> 8) % alphabet.size()] : fill;
+            }
+
+            for (std::size_t from = 0; from <= std::min<std::size_t>(text.size(), 3); ++from) {
+                std::string message = std::string(ScanKernelName(kernel)) + " round " + std::to_string(round) + " from " + std::to_string(from);
+                assertEqual(ScanSpaces(text, from), reference(text, from, [](unsigned char c) { return c == ' ' || c == '\t' || c == '\r'; }), "ScanSpaces, " + message);
+                assertEqual(ScanIdentifier(text, from), reference(text, from, isLetterOrDigit), "ScanIdentifier, " + message);
+                assertEqual(ScanDigits(text, from), reference(text, from, [](unsigned char c) { return '0' <= c && c <= '9'; }), "ScanDigits, " + message);
+                assertEqual(ScanString(text, from), reference(text, from, [](unsigned char c) { return c != '"' && c != '[' && c != 0; }), "ScanString, " + message);
+                assertEqual(ScanLine(text, from), reference(text, from, [](unsigned char c) { return c != '\n' && c != 0; }), "ScanLine, " + message);
+            }
+        }
+        std::cout << ScanKernelName(kernel) << " passed!" << std::endl;
+    }
+    SetScanKernel(original);
+
+    std::cout << "All tests passed!" << std::endl;
+}
+
+// The pre-lexed stream has to hand out exactly the tokens the lexer does,
+// including literals that aren't slices of the text
+void TestTokenStream() {
+    std::string input = R"(BEGIN CODE
+INT x = 10, y
+FLOAT f = 1.5
+STRING s = "a[#]b" & "TRUE" & $
+IF (x == y) # comment
+END CODE)";
+
+    Lexer expected(input);
+    Lexer lexer(input);
+    TokenStream stream(lexer);
+
+    for (std::size_t i = 0; i < stream.Size(); ++i) {
+        Token tok = expected.NextToken();
+        std::cout << "Testing token: " << tok.Literal << " ";
+        assertEqual(stream.Type(i), tok.Type, "Test[" + std::to_string(i) + "] - TokenType wrong.");
+        assertEqual(stream.Literal(i), tok.Literal, "Test[" + std::to_string(i) + "] - Literal wrong.");
+        assertEqual(stream.Line(i), tok.Line, "Test[" + std::to_string(i) + "] - Line wrong.");
+        std::cout << "Test passed!" << std::endl;
+    }
+
+    assertEqual(stream.Type(stream.Size() - 1), EOF_TOKEN, "Last token is not EOF.");
+    assertEqual(stream.At(stream.Size() + 5).Type, EOF_TOKEN, "Reading past the end is not EOF.");
+
+    std::cout << "All tests passed!" << std::endl;
+}
+
+// A Windows checkout has "\r\n" line endings, which have to lex the same as
+// "\n". A lone '\r' is whitespace.
+void TestCrlfLineEndings() {
+    std::string unix = "BEGIN CODE\nINT x = 1 # note\nDISPLAY: x\n\nEND CODE\n";
+    std::string windows = "BEGIN CODE\r\nINT x = 1 # note\r\nDISPLAY: x\r\n\r\nEND CODE\r\n";
+
+    Lexer expected(unix);
+    Lexer lexer(windows);
+    for (std::size_t i = 0; ; ++i) {
+        Token want = expected.NextToken();
+        Token tok = lexer.NextToken();
+        std::cout << "Testing token: " << tok.Literal << " ";
+        assertEqual(tok.Type, want.Type, "Test[" + std::to_string(i) + "] - TokenType wrong.");
+        assertEqual(tok.Literal, want.Literal, "Test[" + std::to_string(i) + "] - Literal wrong.");
+        assertEqual(tok.Line, want.Line, "Test[" + std::to_string(i) + "] - Line wrong.");
+        std::cout << "Test passed!" << std::endl;
+        if (tok.Type == EOF_TOKEN) {
+            break;
+        }
+    }
+
+    Lexer lone("x\ry");
+    assertEqual(lone.NextToken().Literal, "x", "Token before a lone '\\r' wrong.");
+    assertEqual(lone.NextToken().Literal, "y", "Token after a lone '\\r' wrong.");
+
+    std::cout << "All tests passed!" << std::endl;
+}
+
+// Lexing in chunks on several threads has to give the same stream as lexing
+// in one go, also where a cut falls inside a string, a char literal or an
+// [escape] that spans lines
+void TestParallelLexing() {
+    std::string input;
+    for (int i = 0; i < 200; ++i) {
+        input += "INT value" + std::to_string(i) + " = " + std::to_string(i * 37) + " # comment " + std::to_string(i) + "\n";
+        if (i % 7 == 0) {
+            input += "STRING s = \"first line\nsecond line\nthird\" & \"[#]\"\n";
+        }
+        if (i % 11 == 0) {
+            input += "CHAR c = 'x\n'\n";
+        }
+        if (i % 13 == 0) {
+            input += "DISPLAY: [\n]\n\n\n";
+        }
+        input += "IF (x >= 1.5 <> y)\nBEGIN IF\nEND IF\n";
+    }
+    input += "END CODE";
+
+    auto source = std::make_shared<Source>(input);
+    Lexer lexer(source);
+    TokenStream expected(lexer);
+
+    for (std::size_t chunkSize : { 1, 7, 16, 64, 1000 }) {
+        for (unsigned int threads : { 2, 3, 8 }) {
+            TokenStream actual = TokenStream::LexParallel(source, chunkSize, threads);
+            std::string message = "chunk size " + std::to_string(chunkSize) + ", " + std::to_string(threads) + " threads";
+
+            assertEqual(actual.Size(), expected.Size(), "Token count wrong, " + message);
+            for (std::size_t i = 0; i < expected.Size(); ++i) {
+                std::string at = "Test[" + std::to_string(i) + "], " + message;
+                assertEqual(actual.Type(i), expected.Type(i), at + " - TokenType wrong.");
+                assertEqual(actual.Literal(i), expected.Literal(i), at + " - Literal wrong.");
+                assertEqual(actual.Line(i), expected.Line(i), at + " - Line wrong.");
+            }
+            std::cout << message << " passed!" << std::endl;
+        }
+    }
+
+    std::cout << "All tests passed!" << std::endl;
+}
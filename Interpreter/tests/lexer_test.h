@@ -3,4 +3,9 @@
 void TestNextToken();
 void TestNextToken2();
 void TestNextToken2_5();
-void TestNextToken3();
\ No newline at end of file
+void TestNextToken3();
+void TestKeywords();
+void TestScanKernels();
+void TestTokenStream();
+void TestCrlfLineEndings();
+void TestParallelLexing();
\ No newline at end of file
@@ -2,7 +2,7 @@
 
 
 
-static void assertEqual(const std::string& actual, const std::string& expected, const std::string& message) {
+static void assertEqual(std::string_view actual, std::string_view expected, const std::string& message) {
     if (actual != expected) {
         std::cerr << "Assertion failed: " << message << "\n"
             << "Expected: " << expected << ", Actual: " << actual << std::endl;
@@ -1053,8 +1053,8 @@ END FUNCTION
         }
 
         for (size_t i = 0; i < tt.expectedParams.size(); ++i) {
-            if (function->Parameters[i]->TokenLiteral() + " " + function->Parameters[i]->Name->Value != tt.expectedParams[i]) {
-                std::cerr << "Parameter mismatch. Wanted " << tt.expectedParams[i] << ", got " << function->Parameters[i]->TokenLiteral() + " " + function->Parameters[i]->Name->Value << ".\n";
+            if (function->Parameters[i]->TokenLiteral() + " " + function->Parameters[i]->Name->String() != tt.expectedParams[i]) {
+                std::cerr << "Parameter mismatch. Wanted " << tt.expectedParams[i] << ", got " << function->Parameters[i]->TokenLiteral() + " " + function->Parameters[i]->Name->String() << ".\n";
             }
         }
     }
@@ -0,0 +1,535 @@
+#include "vm_test.h"
+
+
+static std::unique_ptr<Program> parse(const std::string& input) {
+    auto lexer = std::make_unique<Lexer>(input);
+    Parser parser(std::move(lexer));
+
+    return parser.ParseProgram();
+}
+
+static Value testRun(const std::string& input) {
+    auto program = parse(input);
+
+    Compiler compiler;
+    if (!compiler.Compile(program.get())) {
+        for (const auto& error : compiler.Errors()) {
+            std::cerr << "compiler error: " << error << std::endl;
+        }
+        std::exit(EXIT_FAILURE);
+    }
+
+    VM vm(compiler.GetBytecode());
+    vm.Run();
+
+    return vm.LastPoppedStackElem();
+}
+
+static bool testIntegerObject(const Value& obj, int64_t expected) {
+    if (!obj.IsInteger()) {
+        std::cerr << "object is not Integer. got=" << (obj ? obj.Inspect() : "nullptr") << std::endl;
+        return false;
+    }
+
+    if (obj.AsInteger() != expected) {
+        std::cerr << "object has wrong value. got=" << obj.AsInteger() << ", want=" << expected << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+static bool testBooleanObject(const Value& obj, bool expected) {
+    if (!obj.IsBoolean()) {
+        std::cerr << "object is not Boolean. got=" << (obj ? obj.Inspect() : "nullptr") << std::endl;
+        return false;
+    }
+
+    if (obj.AsBoolean() != expected) {
+        std::cerr << "object has wrong value. got=" << std::boolalpha << obj.AsBoolean() << ", want=" << expected << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+struct IntegerVMTest {
+    std::string input;
+    int64_t expected;
+};
+
+static void runIntegerVMTests(const std::vector<IntegerVMTest>& tests) {
+    for (const auto& tt : tests) {
+        auto result = testRun(tt.input);
+        if (!testIntegerObject(result, tt.expected)) {
+            std::cerr << "Test failed for input: " << tt.input << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+        std::cout << "Test passed for input: " << tt.input << std::endl;
+    }
+}
+
+void TestCompilerInstructions() {
+    struct TestCase {
+        std::string input;
+        std::string expected;
+    };
+
+    std::vector<TestCase> tests = {
+        {"1 + 2",
+            "0000 OpConstant 0\n"
+            "0005 OpConstant 1\n"
+            "0010 OpAdd\n"
+            "0011 OpPop\n"},
+        {"-1",
+            "0000 OpConstant 0\n"
+            "0005 OpMinus\n"
+            "0006 OpPop\n"},
+        {"INT a = 5",
+            "0000 OpConstant 0\n"
+            "0005 OpDeclareGlobal 0 1 0\n"},
+        {R"(IF ("TRUE")
+    BEGIN IF
+    10
+    END IF)",
+            "0000 OpTrue\n"
+            "0001 OpJumpNotTruthy 16\n"
+            "0006 OpConstant 0\n"
+            "0011 OpJump 17\n"
+            "0016 OpNull\n"
+            "0017 OpPop\n"},
+    };
+
+    for (const auto& tt : tests) {
+        auto program = parse(tt.input);
+
+        Compiler compiler;
+        if (!compiler.Compile(program.get())) {
+            std::cerr << "compiler error for input: " << tt.input << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+
+        std::string actual = InstructionsString(compiler.GetBytecode().Instructions_);
+        if (actual != tt.expected) {
+            std::cerr << "wrong instructions for input: " << tt.input << "\nwant=\n" << tt.expected << "got=\n" << actual << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+        std::cout << "Test passed for input: " << tt.input << std::endl;
+    }
+
+    std::cout << "TestCompilerInstructions passed." << std::endl;
+}
+
+void TestVMIntegerArithmetic() {
+    std::vector<IntegerVMTest> tests = {
+        {"5", 5},
+        {"-10", -10},
+        {"5 + 5 + 5 + 5 - 10", 10},
+        {"2 * 2 * 2 * 2 * 2", 32},
+        {"-50 + 100 + -50", 0},
+        {"5 + 2 * 10", 25},
+        {"50 / 2 * 2 + 10", 60},
+        {"2 * (5 + 10)", 30},
+        {"(5 + 10 * 2 + 15 / 3) * 2 + -10", 50},
+    };
+
+    runIntegerVMTests(tests);
+
+    std::cout << "TestVMIntegerArithmetic passed." << std::endl;
+}
+
+void TestVMBooleanExpressions() {
+    struct TestCase {
+        std::string input;
+        bool expected;
+    };
+
+    std::vector<TestCase> tests = {
+        {R"("TRUE")", true},
+        {R"("FALSE")", false},
+        {"1 < 2", true},
+        {"1 > 2", false},
+        {"1 == 1", true},
+        {"1 <> 1", false},
+        {R"(!"TRUE")", false},
+        {"!!5", true},
+    };
+
+    for (const auto& tt : tests) {
+        auto result = testRun(tt.input);
+        if (!testBooleanObject(result, tt.expected)) {
+            std::cerr << "Test failed for input: " << tt.input << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+        std::cout << "Test passed for input: " << tt.input << std::endl;
+    }
+
+    std::cout << "TestVMBooleanExpressions passed." << std::endl;
+}
+
+void TestVMConditionals() {
+    std::vector<IntegerVMTest> tests = {
+        {R"(IF ("TRUE")
+    BEGIN IF
+    10
+    END IF)", 10},
+        {R"(IF (1 > 2)
+    BEGIN IF
+    10
+    END IF
+    ELSE
+    BEGIN IF
+    20
+    END IF)", 20},
+        {R"(IF (1 > 2)
+    BEGIN IF
+    10
+    END IF
+    ELSE IF (2 > 1)
+    BEGIN IF
+    30
+    END IF
+    ELSE
+    BEGIN IF
+    20
+    END IF)", 30},
+    };
+
+    runIntegerVMTests(tests);
+
+    std::cout << "TestVMConditionals passed." << std::endl;
+}
+
+void TestVMTypedDeclStatements() {
+    std::vector<IntegerVMTest> tests = {
+        {R"(INT a = 5
+            a)", 5},
+        {R"(INT a = 5
+            INT b = a
+            INT c = a + b + 5
+            c)", 15},
+        {R"(INT a
+            a = 5
+            a)", 5},
+        {R"(INT a = 1, b = 2
+            a = b = 7
+            a + b)", 14},
+    };
+
+    runIntegerVMTests(tests);
+
+    std::cout << "TestVMTypedDeclStatements passed." << std::endl;
+}
+
+void TestVMWhileLoop() {
+    std::vector<IntegerVMTest> tests = {
+        {R"(INT i = 0
+            INT sum = 0
+            WHILE (i < 10)
+            BEGIN WHILE
+            sum = sum + i
+            i = i + 1
+            END WHILE
+            sum)", 45},
+        {R"(INT i = 0
+            INT j = 0
+            INT c = 0
+            WHILE (i < 3)
+            BEGIN WHILE
+            j = 0
+            WHILE (j < 4)
+            BEGIN WHILE
+            c = c + 1
+            j = j + 1
+            END WHILE
+            i = i + 1
+            END WHILE
+            c)", 12},
+    };
+
+    runIntegerVMTests(tests);
+
+    std::cout << "TestVMWhileLoop passed." << std::endl;
+}
+
+void TestVMFunctions() {
+    std::vector<IntegerVMTest> tests = {
+        {R"(FUNCTION five() INT:
+    BEGIN FUNCTION
+    RETURN 5
+    END FUNCTION
+    five:)", 5},
+        {R"(INT n = 3
+    FUNCTION double() INT:
+    BEGIN FUNCTION
+    n * 2
+    END FUNCTION
+    double:)", 6},
+        {R"(INT n = 0
+    FUNCTION bump() INT:
+    BEGIN FUNCTION
+    n = n + 1
+    END FUNCTION
+    bump:
+    bump:
+    n)", 2},
+    };
+
+    runIntegerVMTests(tests);
+
+    std::cout << "TestVMFunctions passed." << std::endl;
+}
+
+void TestVMRecursiveFunctions() {
+    std::string input = R"(
+    INT n = 0
+    FUNCTION count() INT:
+    BEGIN FUNCTION
+        n = n + 1
+        IF (n < 5)
+        BEGIN IF
+            count:
+        END IF
+    END FUNCTION
+
+    count:
+    n
+)";
+
+    auto result = testRun(input);
+    if (!testIntegerObject(result, 5)) {
+        std::cerr << "Test failed for input: " << input << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+
+    std::cout << "TestVMRecursiveFunctions passed." << std::endl;
+}
+
+// Every frame keeps four operands on the stack while it waits for the next
+// call, so the stack runs out before the call depth limit. The error ends
+// the call and the program goes on with the next statement.
+void TestVMStackOverflow() {
+    std::string input = R"(
+    INT n = 0
+    INT t = 0
+    FUNCTION count() INT:
+    BEGIN FUNCTION
+        n = n + 1
+        t = 1 == 2 < 3 + 4 * count:
+    END FUNCTION
+
+    count:
+    n > 100
+)";
+
+    auto result = testRun(input);
+    if (!testBooleanObject(result, true)) {
+        std::cerr << "Test failed for input: " << input << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+
+    std::cout << "TestVMStackOverflow passed." << std::endl;
+}
+
+// Runs the program on one engine, in a Runtime of its own so the output can be
+// compared, and returns everything it wrote
+static std::string runEngine(const std::string& input, const std::string& stdinText, bool useVM) {
+    std::FILE* inFile = std::tmpfile();
+    std::FILE* outFile = std::tmpfile();
+    std::fputs(stdinText.c_str(), inFile);
+    std::fflush(inFile);
+    std::rewind(inFile);
+
+    {
+        Output out(outFile, FlushPolicy::Block);
+        Input in(fileno(inFile), true);
+        Runtime runtime(out, in);
+        RuntimeScope scope(runtime);
+
+        auto program = parse(input);
+        if (useVM) {
+            Compiler compiler;
+            if (compiler.Compile(program.get())) {
+                VM vm(compiler.GetBytecode());
+                vm.Run();
+            }
+            for (const auto& error : compiler.Errors()) {
+                out.Write("compiler error: ").Write(error).EndLine();
+            }
+        }
+        else {
+            auto env = MakeRef<Environment>();
+            Resolver(*env).Resolve(program.get());
+            Eval(program.get(), env);
+        }
+        out.Flush();
+    }
+
+    std::string written;
+    char buffer[256];
+    std::rewind(outFile);
+    while (std::size_t size = std::fread(buffer, 1, sizeof(buffer), outFile)) {
+        written.append(buffer, size);
+    }
+    std::fclose(inFile);
+    std::fclose(outFile);
+    return written;
+}
+
+// Programs the VM handles with instructions of its own: parameters, variables
+// of enclosing functions, loop scopes and SCAN into each kind of variable. The
+// evaluator is the reference, both engines have to write the same.
+void TestVMMatchesEvaluator() {
+    struct TestCase {
+        std::string input;
+        std::string stdinText;
+        std::string expected;
+    };
+
+    std::vector<TestCase> tests = {
+        // Parameters
+        {R"(FUNCTION add(INT a, INT b) INT:
+BEGIN FUNCTION
+RETURN a + b
+END FUNCTION
+DISPLAY: add: 4, 5)", "", "9\n"},
+        // A parameter read two functions further in
+        {R"(FUNCTION outer(INT x) INT:
+BEGIN FUNCTION
+FUNCTION mid() INT:
+BEGIN FUNCTION
+FUNCTION in() INT:
+BEGIN FUNCTION
+x * 3
+END FUNCTION
+in:
+END FUNCTION
+mid:
+END FUNCTION
+DISPLAY: outer: 2)", "", "6\n"},
+        // Captured variables are shared, g sees f declared again after it was made
+        {R"(FUNCTION outer() INT:
+BEGIN FUNCTION
+FUNCTION f() INT:
+BEGIN FUNCTION
+1
+END FUNCTION
+FUNCTION g() INT:
+BEGIN FUNCTION
+f:
+END FUNCTION
+FUNCTION f() INT:
+BEGIN FUNCTION
+2
+END FUNCTION
+g:
+END FUNCTION
+DISPLAY: outer:)", "", "2\n"},
+        // Declaring a captured variable updates it in the enclosing function
+        {R"(FUNCTION outer() INT:
+BEGIN FUNCTION
+FUNCTION f() INT:
+BEGIN FUNCTION
+1
+END FUNCTION
+FUNCTION g() INT:
+BEGIN FUNCTION
+FUNCTION f() INT:
+BEGIN FUNCTION
+2
+END FUNCTION
+END FUNCTION
+g:
+f:
+END FUNCTION
+DISPLAY: outer:)", "", "2\n"},
+        // Parameters have no declared type, so assigning one fails in both
+        {R"(FUNCTION outer(INT x) INT:
+BEGIN FUNCTION
+FUNCTION set() INT:
+BEGIN FUNCTION
+x = 5
+END FUNCTION
+set:
+END FUNCTION
+outer: 1
+DISPLAY: 7)", "", "Error: Unknown Identifier: 'x'\n7\n"},
+        // Each iteration starts without the previous one's declarations
+        {R"(INT i = 0
+WHILE (i < 3)
+BEGIN WHILE
+IF (i > 0)
+BEGIN IF
+DISPLAY: step
+END IF
+FUNCTION step() INT:
+BEGIN FUNCTION
+i
+END FUNCTION
+DISPLAY: i
+i = i + 1
+END WHILE
+DISPLAY: i)", "", "0\nError: Identifier not found 'step'\n1\n"},
+        // SCAN into a global
+        {R"(INT n
+SCAN: n
+DISPLAY: n * 2)", "21\n", "42\n"},
+        // SCAN into a parameter, directly and from an inner function
+        {R"(FUNCTION outer(INT x) INT:
+BEGIN FUNCTION
+FUNCTION read() INT:
+BEGIN FUNCTION
+SCAN: x
+END FUNCTION
+read:
+END FUNCTION
+outer: 1
+FUNCTION f(INT x) INT:
+BEGIN FUNCTION
+SCAN: x
+END FUNCTION
+f: 1
+DISPLAY: 7)", "3\n", "Unsupported type for SCAN: FUNCTION\nUnsupported type for SCAN: FUNCTION\n7\n"},
+    };
+
+    for (const auto& tt : tests) {
+        std::string evaluated = runEngine(tt.input, tt.stdinText, false);
+        std::string run = runEngine(tt.input, tt.stdinText, true);
+        if (evaluated != tt.expected || run != tt.expected) {
+            std::cerr << "Test failed for input: " << tt.input << std::endl;
+            std::cerr << "evaluator wrote '" << evaluated << "', VM wrote '" << run << "', want '" << tt.expected << "'" << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+        std::cout << "Test passed for input: " << tt.input << std::endl;
+    }
+
+    std::cout << "TestVMMatchesEvaluator passed." << std::endl;
+}
+
+// An argument count that doesn't fit OpCall's operand is a compile error
+// instead of a call with the wrong count
+void TestVMOperandLimits() {
+    std::string input = "FUNCTION f() INT:\nBEGIN FUNCTION\n1\nEND FUNCTION\nf: 0";
+    for (int i = 1; i < 256; ++i) {
+        input += ", " + std::to_string(i);
+    }
+
+    auto program = parse(input);
+    Compiler compiler;
+    if (compiler.Compile(program.get())) {
+        std::cerr << "compiling a call with 256 arguments succeeded" << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+
+    auto errors = compiler.Errors();
+    std::string expected = "Error: OpCall operand 256 exceeds the limit of 255 (too many variables or arguments)";
+    if (errors.size() != 1 || errors[0] != expected) {
+        std::cerr << "wrong compiler errors, want '" << expected << "'" << std::endl;
+        for (const auto& error : errors) {
+            std::cerr << "got: " << error << std::endl;
+        }
+        std::exit(EXIT_FAILURE);
+    }
+
+    std::cout << "TestVMOperandLimits passed." << std::endl;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "../Lexer.h"
+#include "../Parser.h"
+#include "../Object.h"
+#include "../Compiler.h"
+#include "../VM.h"
+#include "../Evaluator.h"
+
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <string>
+#include <cstdio>
+
+void TestCompilerInstructions();
+void TestVMIntegerArithmetic();
+void TestVMBooleanExpressions();
+void TestVMConditionals();
+void TestVMTypedDeclStatements();
+void TestVMWhileLoop();
+void TestVMFunctions();
+void TestVMRecursiveFunctions();
+void TestVMStackOverflow();
+void TestVMMatchesEvaluator();
+void TestVMOperandLimits();
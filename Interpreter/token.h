@@ -1,82 +1,206 @@
 #pragma once
+#include <array>
+#include <cstdint>
+#include <ostream>
 #include <string>
 #include <string_view>
-#include <unordered_map>
 
 // Token Type Definition
-using TokenType = std::string_view;
+// Token kinds are small integers so the parser can compare them directly and
+// index its tables by kind. TokenTypeName() gives back the printable spelling.
+enum TokenType : std::uint8_t {
+    NONE, // No token yet (default for tokens built by the parser)
 
+    // Special Identifiers
+    ILLEGAL,
+    EOF_TOKEN, // EOF is a macro in C++, so we use EOF_TOKEN
+
+    // Operators
+    ASSIGN,
+    PLUS,
+    MINUS,
+    ASTERISK,
+    SLASH,
+    BANG,
+
+    LT,
+    GT,
+
+    EQ,
+    NEQ,
+    LEQT,
+    GEQT,
+
+    // Delimiters
+    COMMA,
+    COLON,
+    SEMICOLON,
+    LPAREN,
+    RPAREN,
+    LBRACE,
+    RBRACE,
+    LSQBRACE,
+    RSQBRACE,
+    HASH,
+    DOT,
+    S_QUOTE,
+    D_QUOTE,
+    DOLLAR_SIGN,
+    AMPERSAND,
+    NEWLINE,
+
+    // Identifiers
+    IDENT, // varName, foobar, x, y, ...
+    NUM,   // 0123456789
+
+    // Keywords
+    // Literals, Conditionals, etc...
+    FUNCTION,
+    BEGIN,
+    END,
+    CODE,
+    TRUE,
+    FALSE,
+    IF,
+    ELSE,
+    //DISPLAY,
+    RETURN,
+    WHILE,
+    STRING_LITERAL,
+    CHAR_LITERAL,
+
+    // Types
+    INT,
+    CHAR,
+    BOOL,
+    FLOAT,
+    STRING,
+    VOID,
+
+    TOKEN_TYPE_COUNT // Number of token kinds, not a token
+};
+
+// Printable spelling of every token kind, in enum order
+inline constexpr std::array<std::string_view, TOKEN_TYPE_COUNT> TokenTypeNames = {
+    "",
+    "ILLEGAL",
+    "EOF",
+
+    "=",
+    "+",
+    "-",
+    "*",
+    "/",
+    "!",
+
+    "<",
+    ">",
+
+    "==",
+    "<>",
+    "<=",
+    ">=",
+
+    ",",
+    ":",
+    ";",
+    "(",
+    ")",
+    "{",
+    "}",
+    "[",
+    "]",
+    "#",
+    ".",
+    "'",
+    "\"",
+    "$",
+    "&",
+    "\n",
+
+    "IDENT",
+    "NUM",
+
+    "FUNCTION",
+    "BEGIN",
+    "END",
+    "CODE",
+    "TRUE",
+    "FALSE",
+    "IF",
+    "ELSE",
+    "RETURN",
+    "WHILE",
+    "STRING_LITERAL",
+    "CHAR_LITERAL",
+
+    "INT",
+    "CHAR",
+    "BOOL",
+    "FLOAT",
+    "STRING",
+    "VOID",
+};
+
+constexpr std::string_view TokenTypeName(TokenType type) {
+    return type < TOKEN_TYPE_COUNT ? TokenTypeNames[type] : "ILLEGAL";
+}
+
+inline std::ostream& operator<<(std::ostream& out, TokenType type) {
+    return out << TokenTypeName(type);
+}
+
+// Literal is a view into the Source the token was read from (see Source.h),
+// or into static storage for literals that don't come from the text. Line is
+// where the token starts, 0 for tokens the parser makes up.
 struct Token {
-    TokenType Type;
-    std::string Literal;
+    TokenType Type = NONE;
+    std::uint32_t Line = 0; // Fits in the padding after Type
+    std::string_view Literal;
+
+    Token() = default;
+    Token(TokenType type, std::string_view literal, std::uint32_t line = 0)
+        : Type(type), Line(line), Literal(literal) {}
 };
 
-// Token Value Definitions
-// Special Identifiers
-constexpr TokenType ILLEGAL = "ILLEGAL";
-constexpr TokenType EOF_TOKEN = "EOF"; // EOF is a macro in C++, so we use EOF_TOKEN
-
-// Operators
-constexpr TokenType ASSIGN = "=";
-constexpr TokenType PLUS = "+";
-constexpr TokenType MINUS = "-";
-constexpr TokenType ASTERISK = "*";
-constexpr TokenType SLASH = "/";
-constexpr TokenType BANG = "!";
-
-constexpr TokenType LT = "<";
-constexpr TokenType GT = ">";
-
-constexpr TokenType EQ = "==";
-constexpr TokenType NEQ = "<>";
-constexpr TokenType LEQT = "<=";
-constexpr TokenType GEQT = ">=";
-
-// Delimiters
-constexpr TokenType COMMA = ",";
-constexpr TokenType COLON = ":";
-constexpr TokenType SEMICOLON = ";";
-constexpr TokenType LPAREN = "(";
-constexpr TokenType RPAREN = ")";
-constexpr TokenType LBRACE = "{";
-constexpr TokenType RBRACE = "}";
-constexpr TokenType LSQBRACE = "[";
-constexpr TokenType RSQBRACE = "]";
-constexpr TokenType HASH = "#";
-constexpr TokenType DOT = ".";
-constexpr TokenType S_QUOTE = "'";
-constexpr TokenType D_QUOTE = "\"";
-constexpr TokenType DOLLAR_SIGN = "$";
-constexpr TokenType AMPERSAND = "&";
-constexpr TokenType NEWLINE = "\n";
-
-// Identifiers 
-constexpr TokenType IDENT = "IDENT"; // varName, foobar, x, y, ...
-constexpr TokenType NUM = "NUM"; // 0123456789
-
-// Keywords
-// Literals, Conditionals, etc...
-constexpr TokenType FUNCTION = "FUNCTION";
-constexpr TokenType BEGIN = "BEGIN";
-constexpr TokenType END = "END";
-constexpr TokenType CODE = "CODE";
-constexpr TokenType TRUE = "TRUE";
-constexpr TokenType FALSE = "FALSE";
-constexpr TokenType IF = "IF";
-constexpr TokenType ELSE = "ELSE";
-//constexpr TokenType DISPLAY = "DISPLAY";
-constexpr TokenType RETURN = "RETURN";
-constexpr TokenType WHILE = "WHILE";
-constexpr TokenType STRING_LITERAL = "STRING_LITERAL";
-constexpr TokenType CHAR_LITERAL = "CHAR_LITERAL";
-
-// Types
-constexpr TokenType INT = "INT";
-constexpr TokenType CHAR = "CHAR";
-constexpr TokenType BOOL = "BOOL";
-constexpr TokenType FLOAT = "FLOAT";
-constexpr TokenType STRING = "STRING";
-constexpr TokenType VOID = "VOID";
-
-extern std::unordered_map<std::string, std::string_view> keywords;
+// Tells keywords from identifiers for the lexer without hashing a string. The
+// slot of a word is picked from its length and its first and last letters,
+// which differ between all the keywords (checked below), so a lookup is one
+// table index and at most one comparison against the keyword found there.
+class KeywordTable {
+public:
+    static constexpr std::size_t Size = 32;
+
+    constexpr KeywordTable() {
+        for (TokenType type : { FUNCTION, BEGIN, END, CODE, IF, ELSE, RETURN, WHILE,
+                                INT, CHAR, BOOL, FLOAT, STRING, VOID }) {
+            TokenType& entry = slots[slot(TokenTypeName(type))];
+            perfect = perfect && entry == NONE;
+            entry = type;
+        }
+    }
+
+    // The keyword spelled word, or IDENT
+    constexpr TokenType Lookup(std::string_view word) const {
+        if (word.empty()) {
+            return IDENT;
+        }
+        TokenType type = slots[slot(word)];
+        return type != NONE && TokenTypeName(type) == word ? type : IDENT;
+    }
+
+    constexpr bool Perfect() const { return perfect; }
+
+private:
+    std::array<TokenType, Size> slots{};
+    bool perfect = true;
+
+    static constexpr std::size_t slot(std::string_view word) {
+        auto first = static_cast<unsigned char>(word.front());
+        auto last = static_cast<unsigned char>(word.back());
+        return (word.size() * 2 + first + (last << 3)) & (Size - 1);
+    }
+};
 
+inline constexpr KeywordTable Keywords;
+static_assert(Keywords.Perfect(), "two keywords share a slot, change KeywordTable::slot");